@@ -0,0 +1,614 @@
+//Microbenchmarks for the localization hot paths on synthetic inputs.
+//Usage: locate_bench [--filter=<substring>] [--min-time=<seconds>]
+//Reports ns/op and heap allocations/op for every benchmark and input size.
+
+#include "localization/core/association.h"
+#include "localization/core/beam_projector.h"
+#include "localization/core/find_poles.h"
+#include "localization/core/flight_recorder.h"
+#include "localization/core/get_pose.h"
+#include "localization/core/grid_cluster.h"
+#include "localization/core/intensity_classifier.h"
+#include "localization/core/kalman.h"
+#include "localization/core/kalman_kernels.h"
+#include "localization/core/log.h"
+#include "localization/core/map_file.h"
+#include "localization/core/pole_accumulator.h"
+#include "localization/core/pole_store.h"
+#include "localization/core/relocalizer.h"
+#include "localization/core/scan_processing.h"
+#include "localization/core/thread_pool.h"
+#include <Eigen/Dense>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<unsigned long> allocations(0);
+
+}	//namespace
+
+//Counts every heap allocation, Eigen allocates with malloc directly and bypasses operator new (glibc only)
+extern "C" {
+
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t n, std::size_t size);
+void* __libc_realloc(void *p, std::size_t size);
+
+void* malloc(std::size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void* calloc(std::size_t n, std::size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_calloc(n, size);
+}
+
+void* realloc(void *p, std::size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_realloc(p, size);
+}
+
+}
+
+namespace {
+
+using namespace localization_core;
+
+std::string filter;
+double min_time = 0.2;	//seconds each benchmark runs at least
+
+volatile double sink;	//keeps results alive
+
+void Escape(const double &value) {
+	sink = value;
+}
+
+//Runs body until min_time has passed (at least once) and prints the averages.
+//setup runs before every iteration and is not timed.
+template <typename Setup, typename Body>
+void Run(const std::string &name, const long &param, Setup setup, Body body) {
+	if (!filter.empty() && name.find(filter) == std::string::npos) return;
+	typedef std::chrono::steady_clock Clock;
+	long iterations = 0;
+	double total_ns = 0;
+	unsigned long total_allocations = 0;
+	while (iterations == 0 || total_ns < min_time * 1e9) {
+		setup();
+		const unsigned long allocations_before = allocations.load(std::memory_order_relaxed);
+		const Clock::time_point start = Clock::now();
+		body();
+		const Clock::time_point end = Clock::now();
+		total_allocations += allocations.load(std::memory_order_relaxed) - allocations_before;
+		total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+		iterations++;
+	}
+	std::printf("%-32s %9ld %10ld %16.0f %14.1f\n", name.c_str(), param, iterations, total_ns / iterations,
+		(double)total_allocations / iterations);
+	std::fflush(stdout);
+}
+
+void NoSetup() {}
+
+void QuietLog(const LogLevel &, const char *) {}
+
+//Poles spread over a field around the origin with a minimum spacing, like a beach course
+std::vector<PoleLine> MakeMap(const int &n_poles, std::mt19937 *rng) {
+	const double side = std::max(10.0, std::sqrt((double)n_poles) * 3.0);
+	std::uniform_real_distribution<double> coord(-side / 2, side / 2);
+	std::vector<PoleLine> lines;
+	while (lines.size() < n_poles) {
+		PoleLine line;
+		line.p = Eigen::Vector3d(coord(*rng), coord(*rng), 0);
+		bool too_close = false;
+		for (int i = 0; i < lines.size() && !too_close; i++) too_close = (lines[i].p - line.p).norm() < 1.5;
+		if (too_close) continue;
+		line.u = Eigen::Vector3d::UnitZ();
+		line.end = line.p + Eigen::Vector3d(0, 0, 1);
+		line.d = 0.054;
+		lines.push_back(line);
+	}
+	return lines;
+}
+
+Eigen::Vector3d ToLaser(const Eigen::Vector3d &p, const Pose2D &pose) {
+	const double dx = p.x() - pose.x, dy = p.y() - pose.y;
+	return Eigen::Vector3d(cos(pose.theta) * dx + sin(pose.theta) * dy, -sin(pose.theta) * dx + cos(pose.theta) * dy, p.z());
+}
+
+//Map poles with their laser coordinates as seen from pose, all visible
+PoleStore MakePoles(const std::vector<PoleLine> &lines, const Pose2D &pose, std::mt19937 *rng) {
+	std::normal_distribution<double> noise(0, 0.01);
+	PoleStore poles;
+	for (int i = 0; i < lines.size(); i++) {
+		Eigen::Vector3d laser = ToLaser(lines[i].p, pose);
+		laser.x() += noise(*rng);
+		laser.y() += noise(*rng);
+		poles.Add(lines[i], laser, 0.0);
+	}
+	return poles;
+}
+
+//Reflective points of one scan in the laser frame, ordered by bearing, n_points spread over the poles
+std::vector<Eigen::Vector3d> MakeScanPoints(const std::vector<PoleLine> &lines, const Pose2D &pose,
+	const int &n_points, std::mt19937 *rng) {
+	std::normal_distribution<double> noise(0, 0.01);
+	std::vector<Eigen::Vector3d> poles;
+	for (int i = 0; i < lines.size(); i++) poles.push_back(ToLaser(lines[i].p, pose));
+	std::vector<std::pair<double, Eigen::Vector3d> > points;
+	for (int i = 0; i < n_points; i++) {
+		const Eigen::Vector3d &pole = poles[i % poles.size()];
+		const Eigen::Vector3d point(pole.x() + noise(*rng), pole.y() + noise(*rng), 0.35);
+		points.push_back(std::make_pair(atan2(point.y(), point.x()), point));
+	}
+	std::sort(points.begin(), points.end(),
+		[](const std::pair<double, Eigen::Vector3d> &a, const std::pair<double, Eigen::Vector3d> &b) {return a.first < b.first;});
+	std::vector<Eigen::Vector3d> scan;
+	for (int i = 0; i < points.size(); i++) scan.push_back(points[i].second);
+	return scan;
+}
+
+//Points on the surface of n_poles vertical poles as gathered during the initiation sweep
+std::vector<Eigen::Vector3d> MakeSweepCloud(const int &n_points, const int &n_poles, std::mt19937 *rng) {
+	std::vector<PoleLine> lines = MakeMap(n_poles, rng);
+	std::uniform_real_distribution<double> height(0, 1.0);
+	std::uniform_real_distribution<double> angle(-M_PI / 2, M_PI / 2);
+	std::normal_distribution<double> noise(0, 0.005);
+	std::vector<Eigen::Vector3d> cloud;
+	cloud.reserve(n_points);
+	for (int i = 0; i < n_points; i++) {
+		const PoleLine &line = lines[i % lines.size()];
+		const double bearing = atan2(line.p.y(), line.p.x()) + M_PI + angle(*rng);	//side facing the laser
+		cloud.push_back(line.p + Eigen::Vector3d(line.d / 2 * cos(bearing) + noise(*rng),
+			line.d / 2 * sin(bearing) + noise(*rng), height(*rng)));
+	}
+	return cloud;
+}
+
+Pose2D MakePose() {
+	Pose2D pose;
+	pose.x = 0.3;
+	pose.y = -0.2;
+	pose.theta = 0.4;
+	return pose;
+}
+
+void BenchMinimizeScans() {
+	const int sizes[] = {10, 100, 1000, 5000};
+	for (int s = 0; s < 4; s++) {
+		std::mt19937 rng(1);
+		const std::vector<PoleLine> lines = MakeMap(20, &rng);
+		const std::vector<Eigen::Vector3d> cloud = MakeScanPoints(lines, MakePose(), sizes[s], &rng);
+		std::vector<Eigen::Vector3d> scan;
+		Run("MinimizeScans/points", sizes[s], NoSetup, [&]() {
+			MinimizeScans(cloud, &scan);
+			Escape(scan.size());
+		});
+		ScanClusterer clusterer;	//as used by the node, buffers warm after the first scan
+		Run("ScanClusterer/points", sizes[s], NoSetup, [&]() {
+			clusterer.Clear();
+			for (int i = 0; i < cloud.size(); i++) clusterer.Add(cloud[i].x(), cloud[i].y(), cloud[i].z());
+			clusterer.Cluster(&scan);
+			Escape(scan.size());
+		});
+	}
+}
+
+void BenchUpdatePoles() {
+	const int sizes[] = {4, 20, 100, 500, 2000};
+	for (int s = 0; s < 5; s++) {
+		std::mt19937 rng(2);
+		const Pose2D pose = MakePose();
+		const std::vector<PoleLine> lines = MakeMap(sizes[s], &rng);
+		const PoleStore map = MakePoles(lines, pose, &rng);
+		std::vector<Eigen::Vector3d> scans;
+		for (int i = 0; i < map.size(); i++) scans.push_back(map.laser_coords(i));
+		PoleStore poles;
+		Run("UpdatePoles/poles", sizes[s], [&]() {poles = map;}, [&]() {
+			UpdatePoles(scans, pose, 1.0, &poles);
+			Escape(poles.size());
+		});
+		PoleAssociator associator;	//as used by the node
+		Run("PoleAssociator/poles", sizes[s], [&]() {poles = map;}, [&]() {
+			associator.Associate(scans, pose, 1.0, &poles);
+			Escape(poles.size());
+		});
+	}
+}
+
+void BenchKalman() {
+	const int sizes[] = {4, 20, 100, 500};
+	FilterParams params;
+	params.k_s = 0.1;
+	params.k_th = 25.0;
+	params.scan_covariance = 0.004;
+	params.single_precision = false;
+	for (int s = 0; s < 4; s++) {
+		std::mt19937 rng(3);
+		const Pose2D pose = MakePose();
+		const PoleStore poles = MakePoles(MakeMap(sizes[s], &rng), pose, &rng);
+		PoleMeasurements measurements;	//as used by the node
+		Eigen::Vector3d state;
+		Eigen::Matrix3d covariance;
+		Run("Kalman/visible_poles", sizes[s], [&]() {
+			state << pose.x + 0.05, pose.y - 0.05, pose.theta + 0.01;
+			covariance = Eigen::Matrix3d::Identity() * 0.1;
+		}, [&]() {
+			PredictPose(0.04, 1.0, 0.01, 1.0, true, params, &state, &covariance);
+			measurements.Pack(poles);
+			UpdatePose(&measurements, params, &state, &covariance);
+			Escape(state[0]);
+		});
+		Run("Kalman/batch/visible_poles", sizes[s], [&]() {
+			state << pose.x + 0.05, pose.y - 0.05, pose.theta + 0.01;
+			covariance = Eigen::Matrix3d::Identity() * 0.1;
+		}, [&]() {
+			PredictPose(0.04, 1.0, 0.01, 1.0, true, params, &state, &covariance);
+			UpdatePoseBatch(poles, params, &state, &covariance);
+			Escape(state[0]);
+		});
+	}
+}
+
+template <typename T, int Block>
+void RunKalmanKernel(const std::string &name, const PoleStore &poles, const Pose2D &pose,
+	const FilterParams &params) {
+	PackedPoles<T> packed;
+	for (int i = 0; i < poles.size(); i++) packed.Add(poles.x()[i], poles.y()[i], poles.laser_x()[i], poles.laser_y()[i]);
+	Eigen::Matrix<T, 3, 1> state;
+	Eigen::Matrix<T, 3, 3> covariance;
+	Run(name, poles.size(), [&]() {
+		state << pose.x + 0.05, pose.y - 0.05, pose.theta + 0.01;
+		covariance = Eigen::Matrix<T, 3, 3>::Identity() * T(0.1);
+	}, [&]() {
+		PredictKernel<T>(0.04, 1.0, 0.01, 1.0, true, params.k_s, params.k_th, &state, &covariance);
+		UpdateKernel<T, Block>(&packed, params.scan_covariance, &state, &covariance);
+		Escape(state[0]);
+	});
+}
+
+//scalar type and poles per update step of the filter kernels
+void BenchKalmanKernels() {
+	const int sizes[] = {4, 20, 100};
+	FilterParams params;
+	params.k_s = 0.1;
+	params.k_th = 25.0;
+	params.scan_covariance = 0.004;
+	params.single_precision = false;
+	for (int s = 0; s < 3; s++) {
+		std::mt19937 rng(3);
+		const Pose2D pose = MakePose();
+		const PoleStore poles = MakePoles(MakeMap(sizes[s], &rng), pose, &rng);
+		RunKalmanKernel<double, 1>("KalmanKernel/double/block1", poles, pose, params);
+		RunKalmanKernel<double, 2>("KalmanKernel/double/block2", poles, pose, params);
+		RunKalmanKernel<double, 4>("KalmanKernel/double/block4", poles, pose, params);
+		RunKalmanKernel<float, 1>("KalmanKernel/float/block1", poles, pose, params);
+		RunKalmanKernel<float, 2>("KalmanKernel/float/block2", poles, pose, params);
+		RunKalmanKernel<float, 4>("KalmanKernel/float/block4", poles, pose, params);
+		PackedPoles<double> packed;
+		for (int i = 0; i < poles.size(); i++) packed.Add(poles.x()[i], poles.y()[i], poles.laser_x()[i], poles.laser_y()[i]);
+		const Eigen::Vector3d state(pose.x, pose.y, pose.theta);
+		Run("MeasurementModel/double", sizes[s], NoSetup, [&]() {
+			MeasurementModel(state, params.scan_covariance, &packed);
+			Escape(packed.r_x[0]);
+		});
+	}
+}
+
+//core part of one localization cycle with the buffers the node keeps between scans
+void BenchCycle() {
+	const int sizes[] = {4, 20, 100};
+	FilterParams params;
+	params.k_s = 0.1;
+	params.k_th = 25.0;
+	params.scan_covariance = 0.004;
+	params.single_precision = false;
+	for (int s = 0; s < 3; s++) {
+		std::mt19937 rng(3);
+		const Pose2D pose = MakePose();
+		const std::vector<PoleLine> lines = MakeMap(sizes[s], &rng);
+		const PoleStore map = MakePoles(lines, pose, &rng);
+		const std::vector<Eigen::Vector3d> cloud = MakeScanPoints(lines, pose, 20 * sizes[s], &rng);
+		ScanClusterer clusterer;
+		std::vector<Eigen::Vector3d> pole_scans;
+		PoleStore poles = map;
+		PoleMeasurements measurements;
+		PoleAssociator associator;
+		Eigen::Vector3d state;
+		Eigen::Matrix3d covariance;
+		Run("Cycle/poles", sizes[s], [&]() {
+			state << pose.x + 0.05, pose.y - 0.05, pose.theta + 0.01;
+			covariance = Eigen::Matrix3d::Identity() * 0.1;
+		}, [&]() {
+			clusterer.Clear();
+			for (int i = 0; i < cloud.size(); i++) clusterer.Add(cloud[i].x(), cloud[i].y(), cloud[i].z());
+			clusterer.Cluster(&pole_scans);
+			PredictPose(0.04, 1.0, 0.01, 1.0, true, params, &state, &covariance);
+			associator.Associate(pole_scans, pose, 1.0, &poles);
+			measurements.Pack(poles);
+			UpdatePose(&measurements, params, &state, &covariance);
+			EstimateInvisiblePoles(state[2], &poles);
+			Escape(state[0]);
+		});
+	}
+}
+
+void BenchCalcPoles() {
+	const int sizes[] = {10000, 100000, 1000000};
+	for (int s = 0; s < 3; s++) {
+		std::mt19937 rng(4);
+		const std::vector<Eigen::Vector3d> cloud = MakeSweepCloud(sizes[s], 12, &rng);
+		Run("CalcPoles/seed/cloud_points", sizes[s], NoSetup, [&]() {
+			FindPoles find_poles(cloud, FindPoles::kClusterSeed);
+			find_poles.CalcPoles();
+			Escape(find_poles.GetPoles().size());
+		});
+		Run("CalcPoles/grid/cloud_points", sizes[s], NoSetup, [&]() {
+			FindPoles find_poles(cloud, FindPoles::kClusterGrid);
+			find_poles.CalcPoles();
+			Escape(find_poles.GetPoles().size());
+		});
+		Run("CalcPoles/circle/cloud_points", sizes[s], NoSetup, [&]() {
+			FindPoles find_poles(cloud, FindPoles::kClusterGrid);
+			find_poles.SetDiameterMethod(FindPoles::kDiameterCircle);
+			find_poles.CalcPoles();
+			Escape(find_poles.GetPoles().size());
+		});
+		Run("PoleAccumulator/cloud_points", sizes[s], NoSetup, [&]() {
+			PoleAccumulator accumulator;
+			for (int i = 0; i < cloud.size(); i++) accumulator.Add(cloud[i].x(), cloud[i].y(), cloud[i].z());
+			Escape(accumulator.GetPoles().size());
+		});
+		PoleAccumulator accumulator;	//the adaptive sweep asks for the statistics every scan
+		for (int i = 0; i < cloud.size(); i++) accumulator.Add(cloud[i].x(), cloud[i].y(), cloud[i].z());
+		std::vector<PoleStatistics> statistics;
+		Run("PoleAccumulator/statistics/cloud_points", sizes[s], NoSetup, [&]() {
+			accumulator.GetStatistics(&statistics);
+			Escape(statistics.size());
+		});
+	}
+}
+
+//clustering alone on a course with many poles, where comparing with every pole cloud hurts most
+void BenchClusterPoles() {
+	const int sizes[] = {10000, 100000, 1000000};
+	for (int s = 0; s < 3; s++) {
+		std::mt19937 rng(6);
+		const std::vector<Eigen::Vector3d> cloud = MakeSweepCloud(sizes[s], 200, &rng);
+		std::vector<int> labels;
+		Run("GridCluster/cloud_points", sizes[s], NoSetup, [&]() {
+			Escape(GridCluster(cloud, 0.5, &labels));
+		});
+		Run("CalcPoles/seed/200_poles", sizes[s], NoSetup, [&]() {
+			FindPoles find_poles(cloud, FindPoles::kClusterSeed);
+			find_poles.CalcPoles();
+			Escape(find_poles.GetPoles().size());
+		});
+		Run("CalcPoles/grid/200_poles", sizes[s], NoSetup, [&]() {
+			FindPoles find_poles(cloud, FindPoles::kClusterGrid);
+			find_poles.CalcPoles();
+			Escape(find_poles.GetPoles().size());
+		});
+		ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+		Run("CalcPoles/pool/200_poles", sizes[s], NoSetup, [&]() {
+			FindPoles find_poles(cloud, FindPoles::kClusterGrid);
+			find_poles.SetThreadPool(&pool);
+			find_poles.CalcPoles();
+			Escape(find_poles.GetPoles().size());
+		});
+		Run("CalcPoles/pool_trimmed/200_poles", sizes[s], NoSetup, [&]() {
+			FindPoles find_poles(cloud, FindPoles::kClusterGrid);
+			find_poles.SetThreadPool(&pool);
+			find_poles.SetLineFitKeep(0.9);
+			find_poles.CalcPoles();
+			Escape(find_poles.GetPoles().size());
+		});
+	}
+}
+
+//single tilted pole with stray points, the cloud of one cluster
+void BenchFitLine() {
+	const int sizes[] = {1000, 10000, 100000};
+	for (int s = 0; s < 3; s++) {
+		std::mt19937 rng(7);
+		std::vector<Eigen::Vector3d> cloud = MakeSweepCloud(sizes[s], 1, &rng);
+		std::uniform_real_distribution<double> stray(-0.4, 0.4);
+		for (int i = 0; i < cloud.size(); i += 20) cloud[i].x() += stray(rng);
+		Run("FitLineTrimmed/points", sizes[s], NoSetup, [&]() {
+			Escape(FitLineTrimmed(cloud, 0.9).u.z());
+		});
+	}
+}
+
+//one scan of a 0.25 degree laser, a few beams hit poles
+void BenchClassify() {
+	const int sizes[] = {1081, 1440, 8192};
+	const IntensityClassifier classifier = IntensityClassifier::Default();
+	for (int s = 0; s < 3; s++) {
+		std::mt19937 rng(8);
+		std::uniform_real_distribution<float> range(0.1, 12);
+		std::uniform_real_distribution<float> intensity(300, 1200);
+		std::vector<float> ranges(sizes[s]), intensities(sizes[s]);
+		for (int i = 0; i < sizes[s]; i++) {
+			ranges[i] = range(rng);
+			intensities[i] = (i % 50 < 3) ? 2000 : intensity(rng);
+		}
+		Run("IsReflective/beams", sizes[s], NoSetup, [&]() {
+			int count = 0;
+			for (int i = 0; i < sizes[s]; i++) count += classifier.IsReflective(ranges[i], intensities[i]);
+			Escape(count);
+		});
+		std::vector<uint64_t> mask;
+		Run("Classify/beams", sizes[s], NoSetup, [&]() {
+			classifier.Classify(&ranges[0], &intensities[0], sizes[s], &mask);
+			Escape(mask[0]);
+		});
+	}
+}
+
+//projection of the reflective beams only against projecting every beam of the scan
+void BenchProject() {
+	const int sizes[] = {1081, 1440, 8192};
+	const IntensityClassifier classifier = IntensityClassifier::Default();
+	RigidTransform start, end;
+	start.rotation = Eigen::Quaterniond(Eigen::AngleAxisd(0.02, Eigen::Vector3d::UnitX()));
+	start.translation = Eigen::Vector3d(0.05, 0, 0.35);
+	end.rotation = Eigen::Quaterniond(Eigen::AngleAxisd(0.03, Eigen::Vector3d::UnitY()));
+	end.translation = start.translation;
+	for (int s = 0; s < 3; s++) {
+		std::mt19937 rng(9);
+		std::uniform_real_distribution<float> range(0.6, 12);
+		std::vector<float> ranges(sizes[s]), intensities(sizes[s]);
+		for (int i = 0; i < sizes[s]; i++) {
+			ranges[i] = range(rng);
+			intensities[i] = (i % 50 < 3) ? 2000 : 500;
+		}
+		BeamProjector projector;
+		projector.SetGeometry(-M_PI, 2 * M_PI / sizes[s], sizes[s]);
+		std::vector<uint64_t> all((sizes[s] + 63) / 64, ~uint64_t(0));
+		std::vector<uint64_t> mask;
+		std::vector<Eigen::Vector3d> points;
+		std::vector<int> indices;
+		Run("Project/all_beams", sizes[s], NoSetup, [&]() {
+			projector.Project(&ranges[0], all, 0.1, 30, start, end, &points, &indices);
+			Escape(points.size());
+		});
+		Run("Project/reflective_beams", sizes[s], NoSetup, [&]() {
+			classifier.Classify(&ranges[0], &intensities[0], sizes[s], &mask);
+			projector.Project(&ranges[0], mask, 0.1, 30, start, end, &points, &indices);
+			Escape(points.size());
+		});
+	}
+}
+
+void BenchGetPose() {
+	const int sizes[] = {4, 20, 100, 500};
+	for (int s = 0; s < 4; s++) {
+		std::mt19937 rng(5);
+		const PoleStore poles = MakePoles(MakeMap(sizes[s], &rng), MakePose(), &rng);
+		Run("GetPose/poles", sizes[s], NoSetup, [&]() {
+			Escape(GetPose(poles).x);
+		});
+		const Pose2D guess = GetPose(poles);
+		PoseFitParams params;
+		params.max_iterations = 20;
+		params.huber_delta = 0.1;
+		params.scan_covariance = 0.004;
+		Pose2D pose;
+		Eigen::Matrix3d covariance;
+		Run("FitPose/poles", sizes[s], [&]() {pose = guess;}, [&]() {
+			Escape(FitPose(poles, params, &pose, &covariance));
+		});
+	}
+}
+
+void BenchRelocalize() {
+	const int sizes[] = {20, 100, 500, 2000};
+	RelocalizerParams params;
+	params.max_side = 10.0;
+	params.tolerance = 0.05;
+	params.match_distance = 0.2;
+	params.neighbours = 8;
+	params.min_matches = 3;
+	for (int s = 0; s < 4; s++) {
+		std::mt19937 rng(6);
+		const Pose2D pose = MakePose();
+		const PoleStore map = MakePoles(MakeMap(sizes[s], &rng), pose, &rng);
+		std::vector<Eigen::Vector3d> scans;	//poles within laser range
+		for (int i = 0; i < map.size(); i++) {
+			if (map.laser_coords(i).head<2>().norm() < 8.0) scans.push_back(map.laser_coords(i));
+		}
+		Relocalizer relocalizer;
+		relocalizer.Index(map, params);	//also when the index benchmark is filtered out
+		Run("Relocalizer/index/poles", sizes[s], NoSetup, [&]() {
+			relocalizer.Index(map, params);
+			Escape(relocalizer.triangles());
+		});
+		Pose2D found;
+		Run("Relocalize/poles", sizes[s], NoSetup, [&]() {
+			Escape(relocalizer.Relocalize(scans, &found));
+		});
+	}
+}
+
+void BenchMapFile() {
+	const int sizes[] = {20, 2000};
+	const std::string path = "locate_bench_map.bin";
+	for (int s = 0; s < 2; s++) {
+		std::mt19937 rng(7);
+		const PoleStore map = MakePoles(MakeMap(sizes[s], &rng), MakePose(), &rng);
+		Run("MapFile/save/poles", sizes[s], NoSetup, [&]() {
+			Escape(SaveMap(path, map, MakePose()));
+		});
+		PoleStore poles;
+		Pose2D initial_pose;
+		Run("MapFile/load/poles", sizes[s], NoSetup, [&]() {
+			Escape(LoadMap(path, &poles, &initial_pose));
+		});
+	}
+	std::remove(path.c_str());
+}
+
+//cost of one event, alone and with every thread of the pipeline recording at once
+void BenchFlightRecorder() {
+	const int threads[] = {1, 4};
+	for (int t = 0; t < 2; t++) {
+		std::atomic<bool> stop(false);
+		std::vector<std::thread> others;
+		for (int i = 1; i < threads[t]; i++) {
+			others.push_back(std::thread([&stop, i]() {
+				while (!stop.load(std::memory_order_relaxed)) FlightRecord(kFlightAssociation, i, 1.0, 2.0, 0.1);
+			}));
+		}
+		Run("FlightRecord/threads", threads[t], NoSetup, [&]() {
+			FlightRecord(kFlightPose, 3, 1.0, 2.0, 0.5, 0.01, 0.0, 0.0, 0.01, 0.0, 0.001, 12.5);
+		});
+		stop = true;
+		for (int i = 0; i < others.size(); i++) others[i].join();
+	}
+	const std::string path = "locate_bench_flight.bin";
+	Run("FlightRecorder/dump", kFlightRecorderSize, NoSetup, [&]() {
+		Escape(DumpFlightRecorder(path.c_str()));
+	});
+	std::remove(path.c_str());
+}
+
+}	//namespace
+
+int main(int argc, char **argv) {
+	for (int i = 1; i < argc; i++) {
+		if (std::strncmp(argv[i], "--filter=", 9) == 0) filter = argv[i] + 9;
+		else if (std::strncmp(argv[i], "--min-time=", 11) == 0) min_time = std::atof(argv[i] + 11);
+		else {
+			std::fprintf(stderr, "usage: %s [--filter=<substring>] [--min-time=<seconds>]\n", argv[0]);
+			return 1;
+		}
+	}
+	SetLogHandler(QuietLog);
+	std::printf("%-32s %9s %10s %16s %14s\n", "benchmark", "size", "iterations", "ns/op", "allocs/op");
+	BenchMinimizeScans();
+	BenchUpdatePoles();
+	BenchKalman();
+	BenchKalmanKernels();
+	BenchCycle();
+	BenchCalcPoles();
+	BenchClusterPoles();
+	BenchFitLine();
+	BenchClassify();
+	BenchProject();
+	BenchGetPose();
+	BenchRelocalize();
+	BenchMapFile();
+	BenchFlightRecorder();
+	return 0;
+}
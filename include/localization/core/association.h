@@ -0,0 +1,70 @@
+#ifndef LOCALIZATION_CORE_ASSOCIATION_H
+#define LOCALIZATION_CORE_ASSOCIATION_H
+
+#include "localization/core/geometry.h"
+#include "localization/core/grid_index.h"
+#include "localization/core/pole_store.h"
+#include <Eigen/Dense>
+#include <cstdint>
+#include <vector>
+
+namespace localization_core {
+
+//Assigns clustered scan points to the poles of the map and marks poles that got no point as invisible.
+//The map is transformed into the laser frame of the predicted pose once per call and indexed in a grid
+//of cells as large as the widest gate, so every scan point only looks at the poles of 3x3 cells.
+//A scan point and a pole may be paired if they are within 0.2m and 0.1rad bearing (0.4m and 0.2rad if
+//the pole was invisible). Among the gated pairs each pole is claimed by at most one scan point: the
+//pairs are split into connected groups and every group is solved as an assignment problem (Hungarian
+//method) that pairs as many points as possible with the least squared distance. Groups are tiny
+//unless poles stand closer than the gates, so a call costs O(n log n + m log n) for n poles and
+//m scan points. Buffers are kept between calls.
+class PoleAssociator {
+ public:
+	void Associate(const std::vector<Eigen::Vector3d> &scans_to_sort, const Pose2D &pred_pose, const double &stamp,
+		PoleStore *poles);
+
+ private:
+	struct Pair {
+		int group;	//connected group of scan points and poles
+		int scan;
+		int pole;
+		double cost;	//squared distance
+	};
+
+	//map in the predicted laser frame
+	std::vector<double> pole_x_;
+	std::vector<double> pole_y_;
+	GridIndex grid_;	//of pole_x_ and pole_y_
+	std::vector<Pair> pairs_;	//gated pairs
+	std::vector<int> parent_;	//union find over scan points followed by poles
+	std::vector<int> scan_slot_;	//row of a scan point in the cost matrix of its group, -1 if unused
+	std::vector<int> pole_slot_;	//column of a pole in the cost matrix of its group, -1 if unused
+	std::vector<int> group_scans_;
+	std::vector<int> group_poles_;
+	std::vector<double> costs_;	//square cost matrix of one group, row major
+	std::vector<int> assignment_;	//row assigned to every column
+	//scratch of the Hungarian method
+	std::vector<double> row_potential_;
+	std::vector<double> column_potential_;
+	std::vector<double> min_slack_;
+	std::vector<int> way_;
+	std::vector<char> used_;
+
+	void IndexPoles(const PoleStore &poles, const Pose2D &pred_pose);
+	void GatePairs(const std::vector<Eigen::Vector3d> &scans_to_sort, const PoleStore &poles);
+	void Group(const int &n_scans);
+	void Solve(const int &size);
+	int Find(int node);
+};
+
+//Convenience wrapper of PoleAssociator
+void UpdatePoles(const std::vector<Eigen::Vector3d> &scans_to_sort, const Pose2D &pred_pose, const double &stamp,
+	PoleStore *poles);
+
+//Rotates the map position of every invisible pole into the laser frame of a robot with yaw theta
+void EstimateInvisiblePoles(const double &theta, PoleStore *poles);
+
+}	//namespace localization_core
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef LOCALIZATION_CORE_BEAM_PROJECTOR_H
+#define LOCALIZATION_CORE_BEAM_PROJECTOR_H
+
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+#include <cstdint>
+#include <vector>
+
+namespace localization_core {
+
+struct RigidTransform {
+	Eigen::Quaterniond rotation;
+	Eigen::Vector3d translation;
+};
+
+//Projects selected beams of a laser scan into the robot frame. The beam directions are tabulated
+//once per scan geometry and kept, and only the beams set in the mask are touched, so the cost grows
+//with the number of pole returns instead of the beam count. Like laser_geometry, the laser to robot
+//transform is interpolated between scan start and end for every beam to follow a moving laser.
+class BeamProjector {
+ public:
+	BeamProjector();
+	//rebuilds the direction tables only if the geometry differs from the last scan
+	void SetGeometry(const double &angle_min, const double &angle_increment, const int &size);
+	//projects beam i if bit i of mask is set and its range lies in [range_min, range_max],
+	//indices gets the beam of every point
+	void Project(const float *ranges, const std::vector<uint64_t> &mask, const double &range_min,
+		const double &range_max, const RigidTransform &start, const RigidTransform &end,
+		std::vector<Eigen::Vector3d> *points, std::vector<int> *indices) const;
+
+ private:
+	double angle_min_;
+	double angle_increment_;
+	int size_;
+	std::vector<double> cos_;
+	std::vector<double> sin_;
+};
+
+}	//namespace localization_core
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef LOCALIZATION_CORE_FIND_POLES_H
+#define LOCALIZATION_CORE_FIND_POLES_H
+
+#include "localization/core/pole_store.h"
+#include "localization/core/thread_pool.h"
+#include <Eigen/Dense>
+#include <functional>
+#include <vector>
+
+namespace localization_core {
+
+//Line through mean along the main axis of the points' covariance, pointing up, from min_z to max_z
+PoleLine LineFromMoments(const Eigen::Vector3d &mean, const Eigen::Matrix3d &covariance,
+	const double &min_z, const double &max_z);
+
+//Line fit by least trimmed squares: starting from the fit through all points, the keep_fraction of
+//points closest to the line is refitted until the kept set settles. Stray points on one side of a
+//tilted pole then no longer pull the line over. A keep_fraction of 1 or more gives the plain fit.
+PoleLine FitLineTrimmed(const std::vector<Eigen::Vector3d> &points, const double &keep_fraction);
+
+//Finds the poles in the reflective points gathered during the initiation sweep and fits a line
+//with diameter to each of them
+class FindPoles {
+ public:
+	//how the sweep cloud is split into one cloud per pole, points closer than 0.5m belong to one pole
+	enum ClusterMethod {
+		kClusterGrid,	//connected components on a grid, every point in exactly one pole cloud
+		kClusterSeed	//compare every point with the first point of every pole cloud, O(n * poles)
+	};
+	//how the diameter is measured from the points projected on the normal plane of the pole
+	enum DiameterMethod {
+		kDiameterExtent,	//mean lateral extent, seen from the laser, over height bands of ~100 points
+		kDiameterCircle	//least squares circle fit, less sensitive to single outliers
+	};
+
+	explicit FindPoles(const std::vector<Eigen::Vector3d> &cloud, const ClusterMethod &method = kClusterGrid);
+	void CalcPoles();
+	std::vector<PoleLine> GetPoles() const;
+	//fits the poles in parallel on pool, which has to outlive CalcPoles
+	void SetThreadPool(ThreadPool *pool);
+	//fraction of points kept by the trimmed line fit, 1 fits all points
+	void SetLineFitKeep(const double &keep_fraction);
+	void SetDiameterMethod(const DiameterMethod &method);
+
+ private:
+	std::vector<Eigen::Vector3d> cloud_;
+	ClusterMethod method_;
+	ThreadPool *pool_;
+	double keep_fraction_;
+	DiameterMethod diameter_method_;
+	std::vector<std::vector<Eigen::Vector3d> > pole_clouds_;
+	std::vector<PoleLine> lines_;
+
+	void FindPoleClouds();
+	void FindPoleCloudsSeed();
+	void FilterPoleClouds();
+	void FitLines();
+	void FitLine(const int &i);
+	void GetDiameter();
+	void EstimateDiameter(const int &i);
+	void ForEachPole(const std::function<void(int)> &task);
+};
+
+}	//namespace localization_core
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef LOCALIZATION_CORE_FLIGHT_RECORDER_H
+#define LOCALIZATION_CORE_FLIGHT_RECORDER_H
+
+#include <cstdint>
+#include <string>
+
+namespace localization_core {
+
+//Flight recorder: the hot paths record fixed size binary events into one ring instead of formatting log
+//lines. Recording claims a slot with one atomic increment and stores the values, without lock or
+//allocation, so every thread may record. The ring keeps the last kFlightRecorderSize events and is
+//written to a file on demand or from the handler of a fatal signal; flight_decode prints such a dump.
+
+enum FlightEventType {
+	kFlightOdometry,	//wheel increments of one odometry message
+	kFlightAssociation,	//scan point assigned to a pole
+	kFlightAssigned,	//summary of one association pass
+	kFlightInnovation,	//residual of one visible pole at the predicted pose
+	kFlightPose,	//filtered pose, its covariance and the time the filter step took
+	kFlightPoles,	//poles published
+	kFlightEventTypes
+};
+
+const int kFlightValues = 10;
+const uint32_t kFlightRecorderSize = 1 << 16;	//events, a power of two
+const uint32_t kFlightDumpMagic = 0x52464c46;	//"FLFR"
+const uint32_t kFlightDumpVersion = 2;
+
+struct FlightEvent {	//64 bytes
+	uint64_t seq;	//1 + number of events recorded before, 0 while being written
+	uint64_t time_ns;	//steady clock
+	uint16_t type;
+	uint16_t count;	//values used
+	int32_t id;
+	float values[kFlightValues];
+};
+
+//A dump is this header, the whole ring and the number of events recorded once the ring was written
+//(uint64_t), in native byte order. Events recorded meanwhile may have overwritten the slots of the oldest
+//ones while they were copied, so the decoder drops every event older than the last capacity before that
+//number.
+struct FlightDumpHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t event_size;
+	uint32_t capacity;
+	uint64_t recorded;	//events recorded in total, the ring holds the last capacity of them
+	uint64_t steady_ns;	//both clocks at the time of the dump, to give the events wall times
+	uint64_t wall_ns;
+};
+
+//names for decoding; id is 0 if the type does not use it, values are separated by spaces
+struct FlightEventInfo {
+	const char *name;
+	const char *id;
+	const char *values;
+};
+
+//0 for unknown types
+const FlightEventInfo* GetFlightEventInfo(const int &type);
+
+uint64_t FlightClockNs();	//clock of the event times
+void FlightRecordValues(const FlightEventType &type, const int32_t &id, const float *values, const int &count);
+
+//records values as floats, at most kFlightValues
+template <typename... Values>
+inline void FlightRecord(const FlightEventType &type, const int32_t &id, const Values&... values) {
+	const float packed[] = {static_cast<float>(values)...};
+	FlightRecordValues(type, id, packed, sizeof...(values));
+}
+
+//writes the ring to path, only with async signal safe calls; events that may have been torn by recording
+//meanwhile are skipped by the decoder
+bool DumpFlightRecorder(const char *path);
+//dumps to path when the process dies from SIGSEGV, SIGBUS, SIGFPE, SIGILL or SIGABRT, then lets the
+//signal take its default action
+void DumpFlightRecorderOnCrash(const std::string &path);
+
+}	//namespace localization_core
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef LOCALIZATION_CORE_GEOMETRY_H
+#define LOCALIZATION_CORE_GEOMETRY_H
+
+#include <cmath>
+
+namespace localization_core {
+
+struct Pose2D {
+	double x;
+	double y;
+	double theta;	//yaw [rad]
+};
+
+inline void NormalizeAngle(double &angle) {	//keeps angle in [-M_PI, M_PI]
+	angle = std::remainder(angle, 2 * M_PI);
+}
+
+}	//namespace localization_core
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef LOCALIZATION_CORE_GET_POSE_H
+#define LOCALIZATION_CORE_GET_POSE_H
+
+#include "localization/core/geometry.h"
+#include "localization/core/pole_store.h"
+#include <Eigen/Dense>
+
+namespace localization_core {
+
+struct PoseFitParams {
+	int max_iterations;
+	double huber_delta;	//residuals longer than this [m] count linearly, so a wrong pole cannot drag the pose
+	double scan_covariance;	//variance of a laser coordinate [m^2]
+};
+
+//Finds the robot pose without a prior from the map position and the range of all visible poles
+Pose2D GetPose(const PoleStore &poles);
+
+//Levenberg-Marquardt fit of x, y and yaw to the laser coordinates of the visible poles, starting from
+//pose. Same measurement model as the filter, Huber loss, at most max_iterations steps of fixed size
+//matrices. Writes the pose and its covariance and returns false, leaving both untouched, if less than
+//2 poles are visible or the fit does not stay finite.
+bool FitPose(const PoleStore &poles, const PoseFitParams &params, Pose2D *pose, Eigen::Matrix3d *covariance);
+
+}	//namespace localization_core
+
+#endif
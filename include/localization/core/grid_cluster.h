@@ -0,0 +1,19 @@
+#ifndef LOCALIZATION_CORE_GRID_CLUSTER_H
+#define LOCALIZATION_CORE_GRID_CLUSTER_H
+
+#include <Eigen/Dense>
+#include <vector>
+
+namespace localization_core {
+
+//Connected components of points in the xy plane (z is disregarded): two points share a cluster if a
+//chain of points less than radius apart connects them. Points are binned into cells of side
+//radius/sqrt(2), so all points of one cell belong together and only neighbouring cells have to be
+//compared. Runs in O(n log n) for the binning and close to O(n) for the rest.
+//labels gets the cluster of every point, clusters are numbered in the order of their first point.
+//Returns the number of clusters.
+int GridCluster(const std::vector<Eigen::Vector3d> &points, const double &radius, std::vector<int> *labels);
+
+}	//namespace localization_core
+
+#endif
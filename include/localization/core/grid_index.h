@@ -0,0 +1,61 @@
+#ifndef LOCALIZATION_CORE_GRID_INDEX_H
+#define LOCALIZATION_CORE_GRID_INDEX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace localization_core {
+
+//cell of coord in a grid of cells of size
+inline int64_t GridCell(const double &coord, const double &size) {
+	return std::floor(coord / size);
+}
+
+//unique for cells within +-2^31, neighbouring y cells have neighbouring keys
+inline uint64_t GridCellKey(const int64_t &x, const int64_t &y) {
+	return (uint64_t(x + (int64_t(1) << 31)) << 32) | uint64_t(y + (int64_t(1) << 31));
+}
+
+//Points of the plane sorted by the key of their grid cell. Every point closer to a query than the cell
+//size lies in the 3x3 cells around it, and the y cells of one column are a contiguous run of keys, so a
+//query costs three binary searches. The buffer is kept between builds.
+class GridIndex {
+ public:
+	GridIndex() : cell_size_(1) {}
+
+	void Build(const std::vector<double> &x, const std::vector<double> &y, const double &cell_size) {
+		cell_size_ = cell_size;
+		cells_.resize(x.size());
+		for (int j = 0; j < x.size(); j++) {
+			cells_[j] = std::make_pair(GridCellKey(GridCell(x[j], cell_size), GridCell(y[j], cell_size)), j);
+		}
+		std::sort(cells_.begin(), cells_.end());
+	}
+
+	//calls f(j) for every point j in the 3x3 cells around (x, y)
+	template <typename F>
+	void ForEachNear(const double &x, const double &y, F f) const {
+		const int64_t cell_x = GridCell(x, cell_size_), cell_y = GridCell(y, cell_size_);
+		for (int64_t cx = cell_x - 1; cx <= cell_x + 1; cx++) {
+			const uint64_t last = GridCellKey(cx, cell_y + 1);
+			std::vector<std::pair<uint64_t, int> >::const_iterator it = std::lower_bound(cells_.begin(), cells_.end(),
+				std::make_pair(GridCellKey(cx, cell_y - 1), 0), ByKey);
+			for (; it != cells_.end() && it->first <= last; ++it) f(it->second);
+		}
+	}
+
+ private:
+	double cell_size_;
+	std::vector<std::pair<uint64_t, int> > cells_;	//(cell key, point) sorted by key
+
+	static bool ByKey(const std::pair<uint64_t, int> &a, const std::pair<uint64_t, int> &b) {
+		return a.first < b.first;
+	}
+};
+
+}	//namespace localization_core
+
+#endif
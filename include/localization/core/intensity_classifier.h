@@ -0,0 +1,115 @@
+#ifndef LOCALIZATION_CORE_INTENSITY_CLASSIFIER_H
+#define LOCALIZATION_CORE_INTENSITY_CLASSIFIER_H
+
+//Decides which laser beams hit a reflective pole from their range and intensity.
+//The intensity threshold is interpolated linearly between the points of a calibration table and
+//stays at the last value beyond it. Beams closer than min_range or brighter than max_intensity
+//(blinding sunlight) are never reflective. For speed the threshold is tabulated in 1cm cells and
+//a whole scan is classified at once into a bitmask, 8 beams per step with AVX2 when compiled for it.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace localization_core {
+
+struct IntensityCalibration {
+	double range;	//[m]
+	double intensity;	//threshold at that range
+};
+
+class IntensityClassifier {
+ public:
+	//table sorted by ascending range
+	IntensityClassifier(const std::vector<IntensityCalibration> &table, const double &min_range,
+		const double &max_intensity)
+		: min_range_(min_range), max_intensity_(max_intensity), cell_(0.01f) {
+		const double max_range = table.empty() ? min_range : std::max(min_range, table.back().range);
+		const int n_cells = std::ceil((max_range - min_range) / cell_) + 1;
+		start_.resize(n_cells);
+		slope_.resize(n_cells);
+		for (int k = 0; k < n_cells; k++) {
+			const double begin = min_range + k * cell_;
+			start_[k] = Threshold(table, begin);
+			slope_[k] = (Threshold(table, begin + cell_) - start_[k]) / cell_;
+		}
+		slope_.back() = 0;	//constant beyond the table
+	}
+
+	//calibration of the reflective tape used so far
+	static IntensityClassifier Default() {
+		std::vector<IntensityCalibration> table;
+		const IntensityCalibration points[] = {{0.5, 1156.5}, {1.0, 1750}, {3.627, 1375}, {8.0, 931}};
+		table.assign(points, points + 4);
+		return IntensityClassifier(table, 0.5, 3000);
+	}
+
+	bool IsReflective(const float &range, const float &intensity) const {
+		if (!(range >= min_range_)) return false;	//also rejects NaN
+		const int k = std::min<float>((range - min_range_) / cell_, start_.size() - 1);
+		const float threshold = start_[k] + (range - min_range_ - k * cell_) * slope_[k];
+		return intensity > threshold && intensity < max_intensity_;
+	}
+
+	//bit i of mask is set if beam i is reflective, mask gets (n + 63) / 64 words
+	void Classify(const float *ranges, const float *intensities, const int &n, std::vector<uint64_t> *mask) const {
+		mask->assign((n + 63) / 64, 0);
+		int i = 0;
+#ifdef __AVX2__
+		const __m256 min_range = _mm256_set1_ps(min_range_);
+		const __m256 inv_cell = _mm256_set1_ps(1.0f / cell_);
+		const __m256 cell = _mm256_set1_ps(cell_);
+		const __m256 last_cell = _mm256_set1_ps(start_.size() - 1);
+		const __m256 max_intensity = _mm256_set1_ps(max_intensity_);
+		for (; i + 8 <= n; i += 8) {
+			const __m256 range = _mm256_loadu_ps(ranges + i);
+			const __m256 intensity = _mm256_loadu_ps(intensities + i);
+			const __m256 offset = _mm256_sub_ps(range, min_range);
+			const __m256 cell_f = _mm256_floor_ps(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(offset, inv_cell),
+				_mm256_setzero_ps()), last_cell));
+			const __m256i k = _mm256_cvttps_epi32(cell_f);
+			const __m256 start = _mm256_i32gather_ps(&start_[0], k, 4);
+			const __m256 slope = _mm256_i32gather_ps(&slope_[0], k, 4);
+			const __m256 threshold = _mm256_fmadd_ps(_mm256_fnmadd_ps(cell_f, cell, offset), slope, start);
+			__m256 reflective = _mm256_cmp_ps(range, min_range, _CMP_GE_OQ);
+			reflective = _mm256_and_ps(reflective, _mm256_cmp_ps(intensity, threshold, _CMP_GT_OQ));
+			reflective = _mm256_and_ps(reflective, _mm256_cmp_ps(intensity, max_intensity, _CMP_LT_OQ));
+			(*mask)[i / 64] |= uint64_t(_mm256_movemask_ps(reflective)) << (i % 64);
+		}
+#endif
+		for (; i < n; i++) {
+			if (IsReflective(ranges[i], intensities[i])) (*mask)[i / 64] |= uint64_t(1) << (i % 64);
+		}
+	}
+
+	static bool Test(const std::vector<uint64_t> &mask, const int &i) {
+		return (mask[i / 64] >> (i % 64)) & 1;
+	}
+
+ private:
+	float min_range_;
+	float max_intensity_;
+	float cell_;	//width of a table cell [m]
+	std::vector<float> start_;	//threshold at the start of every cell
+	std::vector<float> slope_;	//threshold change per meter within the cell
+
+	static double Threshold(const std::vector<IntensityCalibration> &table, const double &range) {
+		if (table.empty()) return 0;
+		if (range <= table.front().range) return table.front().intensity;
+		for (int j = 1; j < table.size(); j++) {
+			if (range <= table[j].range) {
+				const double t = (range - table[j - 1].range) / (table[j].range - table[j - 1].range);
+				return table[j - 1].intensity + t * (table[j].intensity - table[j - 1].intensity);
+			}
+		}
+		return table.back().intensity;
+	}
+};
+
+}	//namespace localization_core
+
+#endif
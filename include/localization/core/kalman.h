@@ -0,0 +1,64 @@
+#ifndef LOCALIZATION_CORE_KALMAN_H
+#define LOCALIZATION_CORE_KALMAN_H
+
+#include "localization/core/kalman_kernels.h"
+#include "localization/core/pole_store.h"
+#include <Eigen/Dense>
+#include <vector>
+
+namespace localization_core {
+
+struct FilterParams {
+	double k_s;	//covariance parameter for odometry
+	double k_th;	//covariance parameter for imu
+	double scan_covariance;	//covariance of laser scanner
+	bool single_precision;	//run the filter kernels in float, see kalman_kernels.h
+};
+
+//Prediction step of the pose filter. delta_s and delta_theta are the last measured motion increments,
+//the time scales stretch them to the time since the last pose. With translate false the position is
+//kept (no odometry) and only its covariance grows.
+void PredictPose(const double &delta_s, const double &time_scale_pose, const double &delta_theta,
+	const double &time_scale_imu, const bool &translate, const FilterParams &params,
+	Eigen::Vector3d *state, Eigen::Matrix3d *covariance);
+
+//Visible poles packed for UpdatePose. Kept between cycles, packing and updating do not allocate.
+class PoleMeasurements {
+ public:
+	void Pack(const PoleStore &poles);	//takes the visible poles
+	int size() const;
+
+ private:
+	friend void UpdatePose(PoleMeasurements *measurements, const FilterParams &params,
+		Eigen::Vector3d *state, Eigen::Matrix3d *covariance);
+	PackedPoles<double> poles_;
+	PackedPoles<float> poles_f_;	//copy for single precision
+};
+
+//Measurement step with the laser coordinates of all visible poles.
+//R is block diagonal, so the poles are applied one after another, each with a 2x2 innovation solved by
+//LDLT and a Joseph form covariance update. All poles are linearized at the predicted state, which gives
+//the same result as the stacked update in O(k) for k poles.
+void UpdatePose(PoleMeasurements *measurements, const FilterParams &params,
+	Eigen::Vector3d *state, Eigen::Matrix3d *covariance);
+//convenience version that packs the visible poles first
+void UpdatePose(const PoleStore &poles, const FilterParams &params,
+	Eigen::Vector3d *state, Eigen::Matrix3d *covariance);
+
+//Stacked measurement step with the inverse of the 2k x 2k innovation covariance, O(k^3).
+//Reference for UpdatePose.
+void UpdatePoseBatch(const PoleStore &poles, const FilterParams &params,
+	Eigen::Vector3d *state, Eigen::Matrix3d *covariance);
+
+Eigen::Matrix3d StateJacobi(const double &ds, const double &dth, const double &theta);
+Eigen::Matrix<double, 3, 2> InputJacobi(const double &ds, const double &dth, const double &theta, const double &b);
+//stacked measurement model of UpdatePoseBatch
+Eigen::VectorXd EstimateReferencePoint(const PackedPoles<double> &visible_poles, const Eigen::Vector3d &state);
+Eigen::MatrixXd EstimateJacobi(const PackedPoles<double> &visible_poles, const Eigen::Vector3d &state);
+Eigen::MatrixXd ErrorMatrix(const PackedPoles<double> &visible_poles, const Eigen::Vector3d &state,
+	const double &scan_covariance);
+Eigen::VectorXd CalculateMeasuredPoints(const PackedPoles<double> &visible_poles);
+
+}	//namespace localization_core
+
+#endif
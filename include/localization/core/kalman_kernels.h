@@ -0,0 +1,145 @@
+#ifndef LOCALIZATION_CORE_KALMAN_KERNELS_H
+#define LOCALIZATION_CORE_KALMAN_KERNELS_H
+
+//Pose filter steps as templates over the scalar type, so the filter can run in float on boards without
+//a fast double unit. All matrices are fixed size and nothing is allocated.
+//The update processes Block poles per step: a 2*Block dimensional innovation solved by LDLT and a
+//Joseph form covariance update, all poles linearized at the predicted state. Block 1 is the plain
+//sequential update; larger blocks trade a bigger solve for fewer covariance updates.
+
+#include <Eigen/Dense>
+#include <cmath>
+#include <vector>
+
+namespace localization_core {
+
+template <typename T>
+void PredictKernel(const T &delta_s, const T &time_scale_pose, const T &delta_theta, const T &time_scale_imu,
+	const bool &translate, const T &k_s, const T &k_th, Eigen::Matrix<T, 3, 1> *state,
+	Eigen::Matrix<T, 3, 3> *covariance) {
+	using std::abs; using std::cos; using std::sin;
+	Eigen::Matrix<T, 3, 1> &x = *state;
+	//state update
+	x[2] += delta_theta/2*time_scale_imu;	//use leapfrog to find x,y
+	const T c = cos(x[2]), s = sin(x[2]);
+	if (translate) {
+		x[0] += c*delta_s*time_scale_pose;
+		x[1] += s*delta_s*time_scale_pose;
+	}
+	//covariance update
+	Eigen::Matrix<T, 3, 3> f_x;
+	f_x <<
+		1, 0, -s*delta_s*time_scale_pose,
+		0, 1, c*delta_s*time_scale_pose,
+		0, 0, 1;
+	Eigen::Matrix<T, 3, 2> f_u;
+	f_u <<
+		c*time_scale_pose, -T(0.5)*s*delta_s*time_scale_pose,
+		s*time_scale_pose, T(0.5)*c*delta_s*time_scale_pose,
+		0, time_scale_imu;
+	const Eigen::Matrix<T, 2, 1> q_t(abs(delta_s)*time_scale_pose*k_s, abs(delta_theta)*time_scale_imu*k_th);
+	*covariance = f_x*(*covariance)*f_x.transpose() + f_u*q_t.asDiagonal()*f_u.transpose();
+	x[2] += delta_theta/2*time_scale_imu;	//second leap frog step later because cov uses intermediate angle
+}
+
+//Visible poles packed as structure of arrays for the measurement model
+template <typename T>
+struct PackedPoles {
+	std::vector<T> map_x;	//pole position in the map
+	std::vector<T> map_y;
+	std::vector<T> z_x;	//measured laser coordinates
+	std::vector<T> z_y;
+	//written by MeasurementModel. The jacobian rows of pole i are (-c, -s, h_y[i]) and (s, -c, -h_x[i])
+	//with c, s the cosine and sine of the yaw, so they need no arrays of their own.
+	std::vector<T> h_x;	//expected laser coordinates
+	std::vector<T> h_y;
+	std::vector<T> r_x;	//diagonal of the measurement noise
+	std::vector<T> r_y;
+
+	void Clear() {
+		map_x.clear(); map_y.clear(); z_x.clear(); z_y.clear();
+	}
+	void Add(const T &pole_x, const T &pole_y, const T &laser_x, const T &laser_y) {
+		map_x.push_back(pole_x); map_y.push_back(pole_y);
+		z_x.push_back(laser_x); z_y.push_back(laser_y);
+	}
+	template <typename U>
+	void AssignInputs(const PackedPoles<U> &other) {
+		map_x.assign(other.map_x.begin(), other.map_x.end()); map_y.assign(other.map_y.begin(), other.map_y.end());
+		z_x.assign(other.z_x.begin(), other.z_x.end()); z_y.assign(other.z_y.begin(), other.z_y.end());
+	}
+	int size() const {
+		return map_x.size();
+	}
+};
+
+//Measurement model of all packed poles seen from state in one pass: expected laser coordinates h_x and
+//the measurement noise, whose angle terms reduce to ratios of squares, so the loop has no calls and
+//vectorizes over poles.
+template <typename T>
+void MeasurementModel(const Eigen::Matrix<T, 3, 1> &state, const T &scan_covariance, PackedPoles<T> *poles) {
+	using std::cos; using std::sin;
+	const int n = poles->size();
+	poles->h_x.resize(n); poles->h_y.resize(n);
+	poles->r_x.resize(n); poles->r_y.resize(n);
+	if (n == 0) return;
+	const T c = cos(state[2]), s = sin(state[2]);
+	const T x = state[0], y = state[1], theta = state[2];
+	const T *map_x = &poles->map_x[0], *map_y = &poles->map_y[0];
+	T *h_x = &poles->h_x[0], *h_y = &poles->h_y[0], *r_x = &poles->r_x[0], *r_y = &poles->r_y[0];
+	for (int i = 0; i < n; i++) {
+		const T dx = map_x[i] - x, dy = map_y[i] - y;
+		h_x[i] = c*dx + s*dy;
+		h_y[i] = -s*dx + c*dy;
+		//cos^2 and sin^2 of vis_angle = atan2(yp - theta, xp - y), the noise model used so far
+		const T ax = map_x[i] - y, ay = map_y[i] - theta;
+		const T a2 = ax*ax + ay*ay;
+		const T scale = a2 > 0 ? scan_covariance / a2 : 0;
+		r_x[i] = a2 > 0 ? scale*ax*ax : scan_covariance;
+		r_y[i] = scale*ay*ay;
+		//TODO: maybe add variance due to limited angular resolution. Might be fine without due to averaging
+	}
+}
+
+//Applies the Block poles starting at pole i, measurement model evaluated at prior
+template <typename T, int Block>
+void UpdateBlock(const PackedPoles<T> &poles, const int &i, const Eigen::Matrix<T, 3, 1> &prior, const T &c,
+	const T &s, Eigen::Matrix<T, 3, 1> *state, Eigen::Matrix<T, 3, 3> *covariance) {
+	Eigen::Matrix<T, 2 * Block, 1> h_x, R, z;
+	Eigen::Matrix<T, 2 * Block, 3> H;
+	for (int j = 0; j < Block; j++) {
+		h_x.template segment<2>(2 * j) << poles.h_x[i + j], poles.h_y[i + j];
+		H.template block<2, 3>(2 * j, 0) << -c, -s, poles.h_y[i + j],
+			s, -c, -poles.h_x[i + j];
+		R.template segment<2>(2 * j) << poles.r_x[i + j], poles.r_y[i + j];
+		z.template segment<2>(2 * j) << poles.z_x[i + j], poles.z_y[i + j];
+	}
+	Eigen::Matrix<T, 3, 1> &x = *state;
+	Eigen::Matrix<T, 3, 3> &P = *covariance;
+	const Eigen::Matrix<T, 2 * Block, 1> nu = z - h_x - H*(x-prior);	//innovation of the model linearized at prior
+	const Eigen::Matrix<T, 3, 2 * Block> PHt = P*H.transpose();
+	Eigen::Matrix<T, 2 * Block, 2 * Block> S = H*PHt;
+	S.diagonal() += R;
+	const Eigen::LDLT<Eigen::Matrix<T, 2 * Block, 2 * Block> > Sigma(S);
+	const Eigen::Matrix<T, 3, 2 * Block> K = Sigma.solve(PHt.transpose()).transpose();
+	x += K*nu;	//update state with measurement
+	const Eigen::Matrix<T, 3, 3> I_KH = Eigen::Matrix<T, 3, 3>::Identity() - K*H;
+	P = I_KH*P*I_KH.transpose() + K*R.asDiagonal()*K.transpose();	//Joseph form stays symmetric positive definite
+}
+
+template <typename T, int Block>
+void UpdateKernel(PackedPoles<T> *poles, const T &scan_covariance, Eigen::Matrix<T, 3, 1> *state,
+	Eigen::Matrix<T, 3, 3> *covariance) {
+	using std::cos; using std::sin;
+	const Eigen::Matrix<T, 3, 1> prior = *state;	//linearization point of every pole
+	MeasurementModel(prior, scan_covariance, poles);
+	const T c = cos(prior[2]), s = sin(prior[2]);
+	const int n = poles->size();
+	int i = 0;
+	for (; i + Block <= n; i += Block) UpdateBlock<T, Block>(*poles, i, prior, c, s, state, covariance);
+	for (; i < n; i++) UpdateBlock<T, 1>(*poles, i, prior, c, s, state, covariance);	//remaining poles one by one
+}
+
+}	//namespace localization_core
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef LOCALIZATION_CORE_LOG_H
+#define LOCALIZATION_CORE_LOG_H
+
+namespace localization_core {
+
+enum LogLevel {
+	kLogDebug,
+	kLogInfo,
+	kLogWarn,
+	kLogError
+};
+
+typedef void (*LogHandler)(const LogLevel &level, const char *message);
+
+//routes core log output, e.g. to rosconsole; without a handler messages go to stderr
+void SetLogHandler(LogHandler handler);
+void Log(const LogLevel &level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+}	//namespace localization_core
+
+#endif
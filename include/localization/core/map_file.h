@@ -0,0 +1,26 @@
+#ifndef LOCALIZATION_CORE_MAP_FILE_H
+#define LOCALIZATION_CORE_MAP_FILE_H
+
+#include "localization/core/geometry.h"
+#include "localization/core/pole_store.h"
+#include <cstdint>
+#include <string>
+
+namespace localization_core {
+
+//Pole map file, the content of beach_map in native byte order:
+//header (magic, version, pole count, checksum of the records, pose at initiation), then one record of
+//p, u, end and d per pole. Loading maps the file and checks the header, the checksum and that every
+//record holds finite values, a unit direction and a positive diameter before touching the store.
+const uint32_t kMapFileMagic = 0x50414d4c;	//"LMAP"
+const uint32_t kMapFileVersion = 1;
+
+//writes a temporary file next to path and renames it, so a crash never leaves half a map
+bool SaveMap(const std::string &path, const PoleStore &poles, const Pose2D &initial_pose);
+//replaces poles with the stored map, all poles invisible; false and poles untouched if the file is
+//missing, truncated, corrupt, of another version or holds an invalid pole
+bool LoadMap(const std::string &path, PoleStore *poles, Pose2D *initial_pose);
+
+}	//namespace localization_core
+
+#endif
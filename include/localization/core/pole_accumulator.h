@@ -0,0 +1,85 @@
+#ifndef LOCALIZATION_CORE_POLE_ACCUMULATOR_H
+#define LOCALIZATION_CORE_POLE_ACCUMULATOR_H
+
+#include "localization/core/pole_store.h"
+#include <Eigen/Dense>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace localization_core {
+
+//Limits for a pole to count as well defined during the sweep
+struct PoleConvergence {
+	long min_points;
+	double min_z_coverage;	//[m] height the points have to span
+	double max_diameter_error;	//[m] standard error of the mean band extent
+	double max_tilt_error;	//[rad] standard error of the axis direction
+};
+
+//Running fit statistics of one pole
+struct PoleStatistics {
+	long count;
+	double residual;	//[m] rms distance of the points from the fitted axis
+	double diameter_variance;	//[m^2] variance of the extents of the bands with enough points
+	double z_coverage;	//[m] height the points span
+	double diameter_error;	//[m] standard error of the diameter, infinite with less than 2 bands
+	double tilt_error;	//[rad] residual / (axis spread * sqrt(count)), grows when the points span little height
+	bool Converged(const PoleConvergence &limits) const {
+		return count >= limits.min_points && z_coverage >= limits.min_z_coverage &&
+			diameter_error <= limits.max_diameter_error && tilt_error <= limits.max_tilt_error;
+	}
+};
+
+//Streaming counterpart of FindPoles: the points of the initiation sweep are added as the scans arrive
+//and only running moments are kept per pole, so memory does not grow with the sweep duration.
+//A point joins the pole whose first point is closer than 0.5m (ignoring z), otherwise it starts a new pole.
+//Per pole count, mean, scatter matrix and z range give the line, the lateral extent of the points
+//in height bands gives the diameter. Poles with few points are dropped like in FindPoles.
+class PoleAccumulator {
+ public:
+	//band_height: height of the bands the diameter is measured in, tilt of the pole within one band
+	//widens the estimate by band_height * tan(tilt)
+	explicit PoleAccumulator(const double &band_height = 0.05);
+	void Add(const double &x, const double &y, const double &z);
+	void Clear();
+	long points() const;
+	std::vector<PoleLine> GetPoles() const;
+	//statistics of the poles GetPoles would keep, in the same order
+	void GetStatistics(std::vector<PoleStatistics> *statistics) const;
+
+ private:
+	struct Band {
+		double min_lateral;
+		double max_lateral;
+		int count;
+	};
+
+	struct Cluster {
+		Eigen::Vector3d seed;	//first point, moments are kept relative to it
+		Eigen::Vector3d sum;
+		Eigen::Matrix3d scatter;
+		long count;
+		double min_z;
+		double max_z;
+		double cos_bearing;	//lateral direction is perpendicular to the bearing of the seed
+		double sin_bearing;
+		int first_band;
+		std::vector<Band> bands;
+	};
+
+	double band_height_;
+	std::vector<Cluster> clusters_;
+	std::unordered_map<uint64_t, std::vector<int> > clusters_of_cell_;	//clusters by cell of their seed
+	int last_cluster_;	//consecutive points mostly hit the same pole
+	long points_;
+
+	int FindCluster(const double &x, const double &y) const;
+	int NewCluster(const double &x, const double &y, const double &z);
+	bool Kept(const Cluster &cluster) const;
+	double Diameter(const Cluster &cluster) const;
+};
+
+}	//namespace localization_core
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef LOCALIZATION_CORE_POLE_STORE_H
+#define LOCALIZATION_CORE_POLE_STORE_H
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <vector>
+
+namespace localization_core {
+
+//axis of a pole as fitted from its scan points
+struct PoleLine {
+	Eigen::Vector3d p;	//base point
+	Eigen::Vector3d u;	//direction
+	Eigen::Vector3d end;	//end point
+	double d;	//diameter
+};
+
+//The pole map as structure of arrays. The map geometry is fixed after initiation; laser coordinates,
+//visibility and time of last sighting change every scan. Consumers read the arrays they need directly,
+//so a pass over thousands of poles touches only a few contiguous arrays, and visible poles are found
+//word by word in the visibility bitset.
+class PoleStore {
+ public:
+	void Clear();
+	//appends a visible pole seen at laser_coords at time t, returns its index
+	int Add(const PoleLine &line, const Eigen::Vector3d &laser_coords, const double &t);
+	int size() const;
+	bool empty() const;
+
+	//base point of every pole in the map
+	const std::vector<double>& x() const {return x_;}
+	const std::vector<double>& y() const {return y_;}
+	const std::vector<double>& z() const {return z_;}
+	PoleLine line(const int &i) const;	//whole line, for publishing
+
+	//last known laser coordinates of every pole
+	const std::vector<double>& laser_x() const {return laser_x_;}
+	const std::vector<double>& laser_y() const {return laser_y_;}
+	const std::vector<double>& laser_z() const {return laser_z_;}
+	Eigen::Vector3d laser_coords(const int &i) const;
+	//time of last sighting [s]
+	const std::vector<double>& time() const {return time_;}
+
+	//bit i % 64 of word i / 64 is set if pole i is visible
+	const std::vector<uint64_t>& visibility() const {return visible_;}
+	bool visible(const int &i) const {return (visible_[i / 64] >> (i % 64)) & 1;}
+	int CountVisible() const;
+	//calls f(i) for every visible pole in index order
+	template <typename F>
+	void ForEachVisible(F f) const {
+		for (int w = 0; w < visible_.size(); w++) {
+			for (uint64_t bits = visible_[w]; bits; bits &= bits - 1) f(w * 64 + __builtin_ctzll(bits));
+		}
+	}
+
+	//pole i seen at laser_coords at time t
+	void Update(const int &i, const Eigen::Vector3d &laser_coords, const double &t);
+	//estimated laser coordinates of an invisible pole
+	void SetLaserCoords(const int &i, const Eigen::Vector3d &laser_coords);
+	void Disappear(const int &i);
+
+ private:
+	std::vector<double> x_, y_, z_;
+	std::vector<double> u_x_, u_y_, u_z_;	//direction
+	std::vector<double> end_x_, end_y_, end_z_;
+	std::vector<double> d_;	//diameter
+	std::vector<double> laser_x_, laser_y_, laser_z_;
+	std::vector<double> time_;
+	std::vector<uint64_t> visible_;
+};
+
+}	//namespace localization_core
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef LOCALIZATION_CORE_RELOCALIZER_H
+#define LOCALIZATION_CORE_RELOCALIZER_H
+
+#include "localization/core/geometry.h"
+#include "localization/core/grid_index.h"
+#include "localization/core/pole_store.h"
+#include <Eigen/Dense>
+#include <cstdint>
+#include <vector>
+
+namespace localization_core {
+
+struct RelocalizerParams {
+	double max_side;	//longest triangle side that is indexed [m]
+	double tolerance;	//side length error of matching triangles [m]
+	double match_distance;	//distance of a scan point to its pole under a verified pose [m]
+	int neighbours;	//triangles of a pole are formed with its nearest neighbours only
+	int min_matches;	//scan points a pose has to explain to be accepted
+};
+
+//Finds the robot pose in a known map from the clustered scan points of one scan, without a prior.
+//Index hashes the map once: every triangle of a pole and two of its nearest neighbours is keyed by its
+//pairwise distances sorted by length and quantized to the tolerance, plus its orientation, which a
+//rigid motion keeps. Relocalize forms the same triangles from the scan points, looks up map triangles
+//with matching sides in the sorted key table, solves each candidate with GetPose and counts the scan
+//points the candidate pose puts next to a map pole. The pose explaining most points is refined by a
+//least squares rigid fit of all of them. Buffers are kept between calls.
+class Relocalizer {
+ public:
+	Relocalizer() : matches_(0) {}
+	void Index(const PoleStore &poles, const RelocalizerParams &params);
+	//false if no pose explains at least min_matches scan points
+	bool Relocalize(const std::vector<Eigen::Vector3d> &scans, Pose2D *pose);
+	int triangles() const {return triangles_.size();}
+	int matches() const {return matches_;}	//scan points explained by the last pose
+
+ private:
+	struct Triangle {
+		uint64_t key;
+		int vertex[3];	//vertex k lies opposite the k-th shortest side
+	};
+
+	RelocalizerParams params_;
+	std::vector<double> map_x_;
+	std::vector<double> map_y_;
+	std::vector<Triangle> triangles_;	//sorted by key
+	GridIndex grid_;	//of the map poles for verification, cells of match_distance
+	//scratch
+	std::vector<std::pair<double, int> > near_;
+	std::vector<double> scan_x_;
+	std::vector<double> scan_y_;
+	std::vector<Triangle> scan_triangles_;
+	std::vector<int> match_;	//pole matched to every scan point under the tested pose, -1 if none
+	std::vector<int> best_match_;
+	PoleStore candidate_;	//correspondences handed to GetPose
+	Pose2D best_pose_;
+	int best_count_;
+	double best_cost_;
+	int matches_;
+
+	void MakeTriangles(const std::vector<double> &x, const std::vector<double> &y, std::vector<Triangle> *triangles);
+	void Lookup(const double side[3], const int vertex[3], const int &sign);
+	void Test(const int scan[3], const int pole[3]);
+	int CountMatches(const Pose2D &pose, double *cost);
+};
+
+}	//namespace localization_core
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef LOCALIZATION_CORE_SCAN_PROCESSING_H
+#define LOCALIZATION_CORE_SCAN_PROCESSING_H
+
+#include <Eigen/Dense>
+#include <vector>
+
+namespace localization_core {
+
+//timing of the laser scan the points were measured in
+struct ScanTiming {
+	double angle_min;
+	double angle_increment;
+	double time_increment;
+	int size;	//number of beams
+};
+
+//Groups reflective points of one scan belonging to one pole together and averages them.
+//Points have to be added in beam order. A point joins the current cluster if it lies within 0.5m
+//(ignoring z) of the cluster's first point, otherwise it is checked against the previous cluster and
+//then starts a new one, so clustering is a single O(n) pass. The first and last cluster are merged
+//if they belong to the same pole, for scans covering a full turn. Buffers are kept between scans,
+//so once they have grown to the largest scan clustering does not allocate.
+class ScanClusterer {
+ public:
+	void Reserve(const int &n_points);
+	void Clear();
+	void Add(const float &x, const float &y, const float &z);
+	int size() const;
+	//writes the mean of every cluster to scan
+	void Cluster(std::vector<Eigen::Vector3d> *scan);
+
+ private:
+	//points of the current scan
+	std::vector<float> x_;
+	std::vector<float> y_;
+	std::vector<float> z_;
+	//clusters: first point and running sums
+	std::vector<float> seed_x_;
+	std::vector<float> seed_y_;
+	std::vector<float> sum_x_;
+	std::vector<float> sum_y_;
+	std::vector<float> sum_z_;
+	std::vector<int> count_;
+
+	void StartCluster(const int &i);
+	void Join(const int &cluster, const int &i);
+	bool Close(const int &cluster, const int &i) const;
+};
+
+//Convenience wrapper of ScanClusterer for points in beam order
+void MinimizeScans(const std::vector<Eigen::Vector3d> &cloud, std::vector<Eigen::Vector3d> *scan);
+
+//Rotates every point by the yaw the robot turned between its measurement and the end of the scan.
+//delta_theta is the yaw change measured by the imu over delta_t.
+void CorrectMoveError(const ScanTiming &timing, const double &delta_theta, const double &delta_t,
+	std::vector<Eigen::Vector3d> *scan_pole_points);
+
+}	//namespace localization_core
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef LOCALIZATION_CORE_THREAD_POOL_H
+#define LOCALIZATION_CORE_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace localization_core {
+
+//Fixed set of worker threads for data parallel loops. The calling thread works along, so a pool
+//with 0 threads simply runs the loop inline. Only one ParallelFor may run at a time.
+class ThreadPool {
+ public:
+	explicit ThreadPool(const int &n_threads);
+	~ThreadPool();
+	//runs task(0) ... task(n - 1) spread over the threads and returns when all are done
+	void ParallelFor(const int &n, const std::function<void(int)> &task);
+	int size() const;
+
+ private:
+	std::vector<std::thread> threads_;
+	std::mutex mutex_;
+	std::condition_variable work_cv_;
+	std::condition_variable done_cv_;
+	const std::function<void(int)> *task_;
+	int n_tasks_;
+	std::atomic<int> next_task_;
+	int busy_threads_;
+	long generation_;	//counts ParallelFor calls so workers notice new work
+	bool stop_;
+
+	void Worker();
+	void RunTasks();
+
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+};
+
+}	//namespace localization_core
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef LOCALIZATION_INTENSITY_PARAMS_H
+#define LOCALIZATION_INTENSITY_PARAMS_H
+
+#include "localization/core/intensity_classifier.h"
+#include <ros/ros.h>
+#include <vector>
+
+//Reads the intensity calibration shared by locate, laser_angle and laser_filter from the parameters
+//of n, falls back to the default calibration if it is missing or inconsistent
+inline localization_core::IntensityClassifier LoadIntensityClassifier(const ros::NodeHandle &n) {
+	std::vector<double> ranges, thresholds;
+	double min_range, max_intensity;
+	if (!n.getParam("intensity_ranges", ranges) || !n.getParam("intensity_thresholds", thresholds)
+		|| !n.getParam("intensity_min_range", min_range) || !n.getParam("intensity_max", max_intensity)) {
+		ROS_WARN("Didn't find config for intensity calibration, using default");
+		return localization_core::IntensityClassifier::Default();
+	}
+	if (ranges.size() != thresholds.size() || ranges.empty()) {
+		ROS_ERROR("intensity_ranges and intensity_thresholds differ in size, using default calibration");
+		return localization_core::IntensityClassifier::Default();
+	}
+	std::vector<localization_core::IntensityCalibration> table(ranges.size());
+	for (int i = 0; i < ranges.size(); i++) {
+		table[i].range = ranges[i];
+		table[i].intensity = thresholds[i];
+	}
+	return localization_core::IntensityClassifier(table, min_range, max_intensity);
+}
+
+#endif
@@ -1,94 +1,83 @@
-#include <fstream>
-#include <iostream>
-#include <unistd.h>
-#include <cstdlib>
-#include <string>
-#include <SerialStream.h>
-#include "serial/serial.h"
+#ifndef LOCALIZATION_SERIAL_COM_H
+#define LOCALIZATION_SERIAL_COM_H
 
-using namespace std;
+#include "localization/spsc_queue.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <thread>
 
+//Link to the motor controller of the laser suspension, 115200 8N1 without flow control.
+//A dedicated I/O thread owns the port: Send only queues the command line, the thread writes it without
+//blocking, reads the replies as they come and stamps every reply line as the acknowledgement of the
+//oldest unacknowledged command, the controller answers every line once. A reply that echoes a later
+//command acknowledges that one and times out the commands before it. Commands without a reply within
+//ack_timeout are acknowledged as timed out, a late reply echoing one of them is dropped. A reply echoes a
+//command if it holds the whole command line as words, delimited by the reply ends, blanks or punctuation.
+//One thread may send and poll, the I/O thread is the other side of both queues.
 class SerialCom {
  public:
+	typedef std::chrono::steady_clock Clock;
 
- 	void Send(string data) {
- 		data.append("\n");
-		char *out_buf = (char*)data.c_str();
-    ROS_INFO("Writing %s", out_buf);
-    serial_port.write(out_buf, data.length());
-    Listen();
- 	}
-
- 	void Open(const std::string &addr) {
-    serial_port.Open(addr) ;
-    if ( ! serial_port.IsOpen() ) {
-      std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] "
-                   << "Error: Could not open serial port."
-                   << std::endl ;
-      exit(1) ;
-    }
-    // Set the number of data bits.
-    serial_port.SetCharSize( LibSerial::SerialStreamBuf::CHAR_SIZE_8 ) ;
-    if ( ! serial_port.IsOpen() ) {
-      std::cerr << "Error: Could not set the character size." << std::endl ;
-      exit(1) ;
-    }
-    // Disable parity.
-    serial_port.SetParity( LibSerial::SerialStreamBuf::PARITY_NONE ) ;
-    if ( ! serial_port.IsOpen() ) {
-      std::cerr << "Error: Could not disable the parity." << std::endl ;
-      exit(1) ;
-    }
-    // Set the number of stop bits.
-    serial_port.SetNumOfStopBits( 1 ) ;
-    if ( ! serial_port.IsOpen() ) {
-      std::cerr << "Error: Could not set the number of stop bits." << std::endl ;
-      exit(1) ;
-    }
-    // Turn off hardware flow control.
-    serial_port.SetFlowControl( LibSerial::SerialStreamBuf::FLOW_CONTROL_NONE ) ;
-    if ( ! serial_port.IsOpen() ) {
-      std::cerr << "Error: Could not use hardware flow control." << std::endl ;
-      exit(1) ;
-    }
-   /* ROS_INFO("baud rate is %d, should be %d", serial_port.BaudRate(), SerialStreamBuf::BAUD_115200);
-    serial_port.SetBaudRate( SerialStreamBuf::BAUD_115200 ) ;
-    if ( ! serial_port.IsOpen() ) {
-      std::cerr << "Error: Could not set baud rate." << std::endl ;
-      exit(1) ;
-    }*/
-    serial::Serial ser; //necessary because libserial fails to set correct baud rate
-    ser.setPort(addr);
-    ser.setBaudrate(115200);
-    ser.open();
-    ROS_INFO("baud rate enum is %d, should be %d", serial_port.BaudRate(), LibSerial::SerialStreamBuf::BAUD_115200);
-  }
+	struct Ack {
+		uint64_t seq;	//returned by Send
+		std::string command;
+		std::string reply;	//empty if timed out
+		bool timed_out;
+		Clock::time_point sent;	//last byte written
+		Clock::time_point acked;	//reply complete or timeout
+	};
 
-  void Close() {
-    serial_port.Close();
-  }
+	explicit SerialCom(const std::string &address, const double &ack_timeout = 0.5);
+	~SerialCom();	//writes what is queued, for at most 100ms, then closes the port
 
-  SerialCom() {
+	bool IsOpen() const {return fd_ >= 0;}
+	//queues data; returns its sequence number, or 0 if the port is closed or the queue is full
+	uint64_t Send(const std::string &data);
+	bool PollAck(Ack *ack);
+	//commands queued or waiting for their reply
+	int Outstanding() const {return outstanding_.load(std::memory_order_acquire);}
 
-  }
+ private:
+	struct Command {
+		uint64_t seq;
+		std::string line;
+	};
+	struct InFlight {
+		uint64_t seq;
+		std::string command;
+		Clock::time_point sent;
+	};
 
-  SerialCom(const string &addr) {
-    Open(addr);
-  }
+	int fd_;
+	Clock::duration ack_timeout_;
+	uint64_t next_seq_;	//sender side
+	std::atomic<bool> running_;
+	std::atomic<int> outstanding_;
+	std::atomic<int> unwritten_;	//queued or partly written
+	int wake_[2];	//pipe that wakes the I/O thread for a new command
+	SpscQueue<Command> commands_;	//sender to I/O thread
+	SpscQueue<Ack> acks_;	//I/O thread to sender
+	//owned by the I/O thread
+	std::string write_buffer_;	//line being written
+	std::size_t written_;
+	uint64_t writing_seq_;
+	std::string read_buffer_;	//reply line being read
+	std::deque<InFlight> in_flight_;	//written, waiting for a reply
+	std::deque<std::string> timed_out_;	//last commands that timed out
+	std::thread thread_;
 
-  ~SerialCom() {
- 		Close();
- 	}
+	bool Open(const std::string &address);
+	void Loop();
+	void Write();
+	void Read();
+	bool Late(const std::string &reply) const;
+	void Acknowledge(const std::string &reply, const bool &timed_out);
 
- private:
- 	LibSerial::SerialStream serial_port;
- 	string address;
+	SerialCom(const SerialCom&);
+	SerialCom& operator=(const SerialCom&);
+};
 
- 	void Listen() {
-    while(  serial_port.rdbuf()->in_avail() > 0  ){
-      char next_byte;
-      serial_port.get(next_byte);
-      std::cerr << next_byte;
-    }
-	}
-};
\ No newline at end of file
+#endif
@@ -0,0 +1,53 @@
+#ifndef LOCALIZATION_SPSC_QUEUE_H
+#define LOCALIZATION_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+//Bounded lock-free queue for exactly one producer and one consumer thread.
+//Push fails instead of blocking when the queue is full, Pop fails when it is empty.
+//Push and Pop swap item with the slot instead of moving, so item gets back the buffers of an earlier
+//frame and steady state passing needs no allocation. A failed push leaves item untouched.
+template <typename T>
+class SpscQueue {
+ public:
+	explicit SpscQueue(const std::size_t &capacity) : slots_(capacity + 1), head_(0), tail_(0) {}
+
+	bool Push(T &item) {
+		const std::size_t tail = tail_.load(std::memory_order_relaxed);
+		const std::size_t next = Next(tail);
+		if (next == head_.load(std::memory_order_acquire)) return false;	//full
+		std::swap(slots_[tail], item);
+		tail_.store(next, std::memory_order_release);
+		return true;
+	}
+
+	bool Pop(T *item) {
+		const std::size_t head = head_.load(std::memory_order_relaxed);
+		if (head == tail_.load(std::memory_order_acquire)) return false;	//empty
+		std::swap(*item, slots_[head]);
+		head_.store(Next(head), std::memory_order_release);
+		return true;
+	}
+
+	bool Empty() const {
+		return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+	}
+
+ private:
+	std::vector<T> slots_;	//one slot stays free to tell full from empty
+	std::atomic<std::size_t> head_;	//next slot to read, owned by consumer
+	char padding_[64];	//keeps head and tail on separate cache lines
+	std::atomic<std::size_t> tail_;	//next slot to write, owned by producer
+
+	std::size_t Next(const std::size_t &i) const {
+		return (i + 1 == slots_.size()) ? 0 : i + 1;
+	}
+
+	SpscQueue(const SpscQueue&);
+	SpscQueue& operator=(const SpscQueue&);
+};
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef LOCALIZATION_STAGE_TRACE_H
+#define LOCALIZATION_STAGE_TRACE_H
+
+//Per stage latency tracing for the locate node. Build with -DLOCALIZATION_TRACING to enable it,
+//otherwise LOC_TRACE_SCOPE expands to nothing and tracing costs nothing.
+//Every thread records into its own histograms and event ring, so recording takes no lock;
+//only the first record of a thread registers it once.
+
+#ifdef LOCALIZATION_TRACING
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace stage_trace {
+
+enum Stage {
+	kScanToCloud,
+	kMinimizeScans,
+	kCorrectMoveError,
+	kUpdatePoles,
+	kDoTheKalman,
+	kEstimateInvisiblePoles,
+	kRelocalize,
+	kPublishCloud,
+	kPublishPose,
+	kPublishPoles,
+	kPublishTf,
+	kStageCount
+};
+
+inline const char* StageName(const int &stage) {
+	static const char* names[kStageCount] = {"ScanToCloud", "MinimizeScans", "CorrectMoveError", "UpdatePoles",
+		"DoTheKalman", "EstimateInvisiblePoles", "Relocalize", "PublishCloud", "PublishPose", "PublishPoles", "PublishTf"};
+	return names[stage];
+}
+
+//log-linear buckets: 8 sub buckets per power of two of nanoseconds, ~9% resolution
+const int kSubBucketBits = 3;
+const int kBuckets = 64 << kSubBucketBits;
+const std::size_t kEventRingSize = 1 << 16;	//events kept per thread for the chrome trace
+
+inline int BucketOf(const uint64_t &ns) {
+	if (ns < (1u << kSubBucketBits)) return ns;
+	const int msb = 63 - __builtin_clzll(ns);
+	const int sub = (ns >> (msb - kSubBucketBits)) & ((1 << kSubBucketBits) - 1);
+	return ((msb - kSubBucketBits + 1) << kSubBucketBits) + sub;
+}
+
+inline uint64_t BucketUpperBound(const int &bucket) {	//largest value that lands in bucket
+	if (bucket < (1 << kSubBucketBits)) return bucket;
+	const int msb = (bucket >> kSubBucketBits) + kSubBucketBits - 1;
+	const uint64_t sub = bucket & ((1 << kSubBucketBits) - 1);
+	const uint64_t base = (uint64_t(1) << msb) + (sub << (msb - kSubBucketBits));
+	return base + (uint64_t(1) << (msb - kSubBucketBits)) - 1;
+}
+
+struct Event {
+	uint64_t start_ns;
+	uint32_t duration_ns;
+	uint32_t stage;
+};
+
+//written only by its owning thread, read by the reporting thread with relaxed loads
+struct ThreadTrace {
+	std::atomic<uint64_t> counts[kStageCount][kBuckets];
+	std::atomic<uint64_t> max_ns[kStageCount];
+	std::vector<Event> events;
+	std::atomic<uint64_t> event_count;
+	int tid;
+
+	explicit ThreadTrace(const int &id) : events(kEventRingSize), event_count(0), tid(id) {
+		for (int s = 0; s < kStageCount; s++) {
+			for (int b = 0; b < kBuckets; b++) counts[s][b].store(0, std::memory_order_relaxed);
+			max_ns[s].store(0, std::memory_order_relaxed);
+		}
+	}
+};
+
+struct Registry {
+	std::mutex mutex;
+	std::vector<ThreadTrace*> threads;	//never freed, threads may record until exit
+	std::atomic<bool> record_events;
+	Registry() : record_events(false) {}
+};
+
+inline Registry& GetRegistry() {
+	static Registry registry;
+	return registry;
+}
+
+inline ThreadTrace& LocalTrace() {
+	static thread_local ThreadTrace *trace = 0;
+	if (!trace) {
+		Registry &registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		trace = new ThreadTrace(registry.threads.size());
+		registry.threads.push_back(trace);
+	}
+	return *trace;
+}
+
+inline uint64_t NowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void Record(const int &stage, const uint64_t &start_ns, const uint64_t &duration_ns) {
+	ThreadTrace &trace = LocalTrace();
+	std::atomic<uint64_t> &count = trace.counts[stage][BucketOf(duration_ns)];
+	count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	if (duration_ns > trace.max_ns[stage].load(std::memory_order_relaxed)) {
+		trace.max_ns[stage].store(duration_ns, std::memory_order_relaxed);
+	}
+	if (GetRegistry().record_events.load(std::memory_order_relaxed)) {
+		const uint64_t n = trace.event_count.load(std::memory_order_relaxed);
+		Event &event = trace.events[n % kEventRingSize];
+		event.start_ns = start_ns;
+		event.duration_ns = std::min<uint64_t>(duration_ns, UINT32_MAX);
+		event.stage = stage;
+		trace.event_count.store(n + 1, std::memory_order_release);
+	}
+}
+
+//keeps the chrome trace event ring of every thread filled from now on
+inline void EnableEvents() {
+	GetRegistry().record_events = true;
+}
+
+struct Summary {
+	uint64_t count;
+	uint64_t p50_ns;
+	uint64_t p99_ns;
+	uint64_t max_ns;
+};
+
+//merges the histograms of all threads; percentiles are bucket upper bounds
+inline void Summarize(std::vector<Summary> *summaries) {
+	Registry &registry = GetRegistry();
+	std::vector<ThreadTrace*> threads;
+	{
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		threads = registry.threads;
+	}
+	summaries->assign(kStageCount, Summary());
+	std::vector<uint64_t> merged(kBuckets);
+	for (int s = 0; s < kStageCount; s++) {
+		Summary &summary = summaries->at(s);
+		summary.count = summary.p50_ns = summary.p99_ns = summary.max_ns = 0;
+		std::fill(merged.begin(), merged.end(), 0);
+		for (int t = 0; t < threads.size(); t++) {
+			for (int b = 0; b < kBuckets; b++) merged[b] += threads[t]->counts[s][b].load(std::memory_order_relaxed);
+			summary.max_ns = std::max(summary.max_ns, threads[t]->max_ns[s].load(std::memory_order_relaxed));
+		}
+		for (int b = 0; b < kBuckets; b++) summary.count += merged[b];
+		if (summary.count == 0) continue;
+		const uint64_t rank50 = (summary.count + 1) / 2;
+		const uint64_t rank99 = summary.count - summary.count / 100;
+		uint64_t seen = 0;
+		for (int b = 0; b < kBuckets; b++) {
+			const uint64_t before = seen;
+			seen += merged[b];
+			if (before < rank50 && seen >= rank50) summary.p50_ns = BucketUpperBound(b);
+			if (before < rank99 && seen >= rank99) summary.p99_ns = BucketUpperBound(b);
+		}
+		summary.p50_ns = std::min(summary.p50_ns, summary.max_ns);
+		summary.p99_ns = std::min(summary.p99_ns, summary.max_ns);
+	}
+}
+
+//writes the recorded events in chrome trace event format (chrome://tracing, perfetto)
+inline bool DumpChromeTrace(const std::string &path) {
+	std::ofstream out(path.c_str());
+	if (!out.is_open()) return false;
+	Registry &registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	out << "{\"traceEvents\":[";
+	bool first = true;
+	for (int t = 0; t < registry.threads.size(); t++) {
+		const ThreadTrace &trace = *registry.threads[t];
+		const uint64_t n = trace.event_count.load(std::memory_order_acquire);
+		const uint64_t begin = n > kEventRingSize ? n - kEventRingSize : 0;
+		for (uint64_t i = begin; i < n; i++) {
+			const Event &event = trace.events[i % kEventRingSize];
+			if (!first) out << ",";
+			first = false;
+			out << "{\"name\":\"" << StageName(event.stage) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << trace.tid
+				<< ",\"ts\":" << event.start_ns / 1000.0 << ",\"dur\":" << event.duration_ns / 1000.0 << "}";
+		}
+	}
+	out << "]}\n";
+	return true;
+}
+
+class ScopedTimer {
+ public:
+	explicit ScopedTimer(const int &stage) : stage_(stage), start_ns_(NowNs()) {}
+	~ScopedTimer() {
+		Record(stage_, start_ns_, NowNs() - start_ns_);
+	}
+
+ private:
+	int stage_;
+	uint64_t start_ns_;
+};
+
+}	//namespace stage_trace
+
+#define LOC_TRACE_CONCAT_(a, b) a##b
+#define LOC_TRACE_CONCAT(a, b) LOC_TRACE_CONCAT_(a, b)
+#define LOC_TRACE_SCOPE(stage) stage_trace::ScopedTimer LOC_TRACE_CONCAT(stage_timer_, __LINE__)(stage_trace::stage)
+
+#else
+
+#define LOC_TRACE_SCOPE(stage)
+
+#endif
+
+#endif
@@ -0,0 +1,198 @@
+#include "localization/core/association.h"
+#include "localization/core/flight_recorder.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace localization_core {
+
+namespace {
+
+const double kCellSize = 0.4;	//widest gate, so gated poles lie in the 3x3 cells around a scan point
+const double kUnassigned = 1e3;	//cost of an ungated cell of a group's cost matrix, far above any gated cost
+
+}	//namespace
+
+void PoleAssociator::Associate(const std::vector<Eigen::Vector3d> &scans_to_sort, const Pose2D &pred_pose,
+	const double &stamp, PoleStore *poles) {
+	if (poles->empty()) return;
+	PoleStore &map = *poles;
+	IndexPoles(map, pred_pose);
+	GatePairs(scans_to_sort, map);
+	Group(scans_to_sort.size());
+	scan_slot_.assign(scans_to_sort.size(), -1);
+	pole_slot_.assign(map.size(), -1);
+	int n_assigned = 0;
+	for (int begin = 0, end = 0; begin < pairs_.size(); begin = end) {
+		while (end < pairs_.size() && pairs_[end].group == pairs_[begin].group) end++;
+		if (end - begin == 1) {	//one scan point and one pole, nothing to decide
+			const Eigen::Vector3d &scan = scans_to_sort[pairs_[begin].scan];
+			map.Update(pairs_[begin].pole, scan, stamp);
+			FlightRecord(kFlightAssociation, pairs_[begin].pole, scan.x(), scan.y(), pairs_[begin].cost);
+			n_assigned++;
+			continue;
+		}
+		group_scans_.clear();
+		group_poles_.clear();
+		for (int k = begin; k < end; k++) {
+			if (scan_slot_[pairs_[k].scan] < 0) {
+				scan_slot_[pairs_[k].scan] = group_scans_.size();
+				group_scans_.push_back(pairs_[k].scan);
+			}
+			if (pole_slot_[pairs_[k].pole] < 0) {
+				pole_slot_[pairs_[k].pole] = group_poles_.size();
+				group_poles_.push_back(pairs_[k].pole);
+			}
+		}
+		const int size = std::max(group_scans_.size(), group_poles_.size());
+		costs_.assign(size * size, kUnassigned);
+		for (int k = begin; k < end; k++) {
+			costs_[scan_slot_[pairs_[k].scan] * size + pole_slot_[pairs_[k].pole]] = pairs_[k].cost;
+		}
+		Solve(size);
+		for (int column = 0; column < group_poles_.size(); column++) {
+			const int row = assignment_[column + 1] - 1;
+			if (row < group_scans_.size() && costs_[row * size + column] < kUnassigned) {
+				const Eigen::Vector3d &scan = scans_to_sort[group_scans_[row]];
+				map.Update(group_poles_[column], scan, stamp);
+				FlightRecord(kFlightAssociation, group_poles_[column], scan.x(), scan.y(), costs_[row * size + column]);
+				n_assigned++;
+			}
+		}
+		for (int k = 0; k < group_scans_.size(); k++) scan_slot_[group_scans_[k]] = -1;
+		for (int k = 0; k < group_poles_.size(); k++) pole_slot_[group_poles_[k]] = -1;
+	}
+	const std::vector<double> &time = map.time();
+	for (int i = 0; i < map.size(); i++) {	//hide all missing poles
+		if (time[i] != stamp) map.Disappear(i);
+	}
+	FlightRecord(kFlightAssigned, n_assigned, scans_to_sort.size(), map.size());
+}
+
+void PoleAssociator::IndexPoles(const PoleStore &poles, const Pose2D &pred_pose) {
+	const int n = poles.size();
+	pole_x_.resize(n);
+	pole_y_.resize(n);
+	const double c = cos(pred_pose.theta), s = sin(pred_pose.theta);
+	for (int j = 0; j < n; j++) {
+		const double dx = poles.x()[j] - pred_pose.x;
+		const double dy = poles.y()[j] - pred_pose.y;
+		pole_x_[j] = c * dx + s * dy;
+		pole_y_[j] = -s * dx + c * dy;
+	}
+	grid_.Build(pole_x_, pole_y_, kCellSize);
+}
+
+void PoleAssociator::GatePairs(const std::vector<Eigen::Vector3d> &scans_to_sort, const PoleStore &poles) {
+	pairs_.clear();
+	for (int i = 0; i < scans_to_sort.size(); i++) {
+		const double x = scans_to_sort[i].x(), y = scans_to_sort[i].y();
+		if (!std::isfinite(x) || !std::isfinite(y)) continue;
+		const double bearing = atan2(y, x);
+		grid_.ForEachNear(x, y, [&](const int &j) {
+			const double dist = (x - pole_x_[j]) * (x - pole_x_[j]) + (y - pole_y_[j]) * (y - pole_y_[j]);
+			const bool visible = poles.visible(j);	//more tolerance if pole wasn't visible
+			const double max_dist = visible ? 0.2 : 0.4;
+			if (!(dist < max_dist * max_dist)) return;
+			double angle = bearing - atan2(pole_y_[j], pole_x_[j]);
+			NormalizeAngle(angle);
+			if (!(std::abs(angle) < (visible ? 0.1 : 0.2))) return;
+			Pair pair;
+			pair.group = -1;
+			pair.scan = i;
+			pair.pole = j;
+			pair.cost = dist;
+			pairs_.push_back(pair);
+		});
+	}
+}
+
+//labels every pair with the connected group of scan points and poles it belongs to and sorts by group
+void PoleAssociator::Group(const int &n_scans) {
+	parent_.resize(n_scans + pole_x_.size());
+	for (int i = 0; i < parent_.size(); i++) parent_[i] = i;
+	for (int k = 0; k < pairs_.size(); k++) {
+		const int a = Find(pairs_[k].scan), b = Find(n_scans + pairs_[k].pole);
+		if (a != b) parent_[b] = a;
+	}
+	for (int k = 0; k < pairs_.size(); k++) pairs_[k].group = Find(pairs_[k].scan);
+	std::sort(pairs_.begin(), pairs_.end(), [](const Pair &a, const Pair &b) {
+		return a.group != b.group ? a.group < b.group : a.scan != b.scan ? a.scan < b.scan : a.pole < b.pole;
+	});
+}
+
+int PoleAssociator::Find(int node) {
+	while (parent_[node] != node) {
+		parent_[node] = parent_[parent_[node]];	//path halving
+		node = parent_[node];
+	}
+	return node;
+}
+
+//Hungarian method on the size x size matrix in costs_, O(size^3).
+//Afterwards row assignment_[j] - 1 is assigned to column j - 1 (both 1-based with 0 as sentinel).
+void PoleAssociator::Solve(const int &size) {
+	const double inf = std::numeric_limits<double>::infinity();
+	row_potential_.assign(size + 1, 0);
+	column_potential_.assign(size + 1, 0);
+	assignment_.assign(size + 1, 0);
+	way_.assign(size + 1, 0);
+	for (int i = 1; i <= size; i++) {
+		assignment_[0] = i;
+		int j0 = 0;
+		min_slack_.assign(size + 1, inf);
+		used_.assign(size + 1, 0);
+		do {	//grow alternating tree until a free column is reached
+			used_[j0] = 1;
+			const int i0 = assignment_[j0];
+			double delta = inf;
+			int j1 = 0;
+			for (int j = 1; j <= size; j++) {
+				if (used_[j]) continue;
+				const double slack = costs_[(i0 - 1) * size + j - 1] - row_potential_[i0] - column_potential_[j];
+				if (slack < min_slack_[j]) {
+					min_slack_[j] = slack;
+					way_[j] = j0;
+				}
+				if (min_slack_[j] < delta) {
+					delta = min_slack_[j];
+					j1 = j;
+				}
+			}
+			for (int j = 0; j <= size; j++) {
+				if (used_[j]) {
+					row_potential_[assignment_[j]] += delta;
+					column_potential_[j] -= delta;
+				}
+				else min_slack_[j] -= delta;
+			}
+			j0 = j1;
+		} while (assignment_[j0] != 0);
+		do {	//flip the augmenting path
+			const int j1 = way_[j0];
+			assignment_[j0] = assignment_[j1];
+			j0 = j1;
+		} while (j0 != 0);
+	}
+}
+
+void UpdatePoles(const std::vector<Eigen::Vector3d> &scans_to_sort, const Pose2D &pred_pose, const double &stamp,
+	PoleStore *poles) {
+	PoleAssociator associator;
+	associator.Associate(scans_to_sort, pred_pose, stamp, poles);
+}
+
+void EstimateInvisiblePoles(const double &theta, PoleStore *poles) {
+	Eigen::Matrix3d rot;
+	rot = Eigen::AngleAxis<double>(-theta, Eigen::Vector3d::UnitZ());
+	const std::vector<uint64_t> &visibility = poles->visibility();
+	for (int w = 0; w < visibility.size(); w++) {
+		for (uint64_t hidden = ~visibility[w]; hidden; hidden &= hidden - 1) {
+			const int i = w * 64 + __builtin_ctzll(hidden);
+			if (i >= poles->size()) break;
+			poles->SetLaserCoords(i, rot * Eigen::Vector3d(poles->x()[i], poles->y()[i], poles->z()[i]));
+		}
+	}
+}
+
+}	//namespace localization_core
@@ -0,0 +1,41 @@
+#include "localization/core/beam_projector.h"
+#include <cmath>
+
+namespace localization_core {
+
+BeamProjector::BeamProjector() : angle_min_(0), angle_increment_(0), size_(0) {}
+
+void BeamProjector::SetGeometry(const double &angle_min, const double &angle_increment, const int &size) {
+	if (size == size_ && angle_min == angle_min_ && angle_increment == angle_increment_) return;
+	angle_min_ = angle_min;
+	angle_increment_ = angle_increment;
+	size_ = size;
+	cos_.resize(size);
+	sin_.resize(size);
+	for (int i = 0; i < size; i++) {
+		cos_[i] = cos(angle_min + i * angle_increment);
+		sin_[i] = sin(angle_min + i * angle_increment);
+	}
+}
+
+void BeamProjector::Project(const float *ranges, const std::vector<uint64_t> &mask, const double &range_min,
+	const double &range_max, const RigidTransform &start, const RigidTransform &end,
+	std::vector<Eigen::Vector3d> *points, std::vector<int> *indices) const {
+	points->clear();
+	indices->clear();
+	for (int word = 0; word < mask.size(); word++) {
+		for (uint64_t bits = mask[word]; bits != 0; bits &= bits - 1) {	//only the set bits
+			const int i = word * 64 + __builtin_ctzll(bits);
+			if (i >= size_) return;
+			const double range = ranges[i];
+			if (!(range >= range_min && range <= range_max)) continue;
+			const double ratio = size_ > 1 ? (double)i / (size_ - 1) : 0;	//beam time within the scan
+			const Eigen::Quaterniond rotation = start.rotation.slerp(ratio, end.rotation);
+			const Eigen::Vector3d translation = start.translation + ratio * (end.translation - start.translation);
+			points->push_back(rotation * Eigen::Vector3d(range * cos_[i], range * sin_[i], 0) + translation);
+			indices->push_back(i);
+		}
+	}
+}
+
+}	//namespace localization_core
@@ -0,0 +1,259 @@
+#include "localization/core/find_poles.h"
+#include "localization/core/grid_cluster.h"
+#include "localization/core/log.h"
+#include <Eigen/Eigenvalues>
+#include <algorithm>
+#include <cmath>
+
+namespace localization_core {
+
+namespace {
+
+const int kBandPoints = 100;	//points per height band on average
+const int kMinBandPoints = 10;	//bands with fewer points underestimate the diameter
+
+//Algebraic (Kasa) circle fit x^2 + y^2 + D x + E y + F = 0 in the least squares sense
+double CircleDiameter(const Eigen::ArrayXf &s, const Eigen::ArrayXf &t) {
+	const int n = s.size();
+	if (n < 3) return 0;
+	const double mean_s = s.mean(), mean_t = t.mean();
+	const Eigen::ArrayXf cs = s - mean_s, ct = t - mean_t;	//centered for conditioning
+	const Eigen::ArrayXf w = cs.square() + ct.square();
+	Eigen::Matrix3d a;
+	a << cs.square().sum(), (cs * ct).sum(), cs.sum(),
+		(cs * ct).sum(), ct.square().sum(), ct.sum(),
+		cs.sum(), ct.sum(), n;
+	const Eigen::Vector3d b(-(cs * w).sum(), -(ct * w).sum(), -w.sum());
+	const Eigen::Vector3d def = a.ldlt().solve(b);
+	const double r2 = def[0] * def[0] / 4 + def[1] * def[1] / 4 - def[2];
+	return r2 > 0 ? 2 * std::sqrt(r2) : 0;
+}
+
+}	//namespace
+
+PoleLine LineFromMoments(const Eigen::Vector3d &mean, const Eigen::Matrix3d &covariance,
+	const double &min_z, const double &max_z) {
+	//closed form for symmetric 3x3 matrices, eigenvalues come sorted ascending
+	Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+	solver.computeDirect(covariance);
+	Eigen::Vector3d u = solver.eigenvectors().col(2);	//direction of biggest eigenvalue
+	if (u.z() < 0) u *= -1;	//make direction point up
+	PoleLine line;
+	line.u = u;
+	//find real base of pole
+	const double scale_min = (min_z - mean.z())/u.z();
+	line.p = mean + scale_min*u;
+	//find top end of pole
+	const double scale_max = (max_z - mean.z())/u.z();
+	line.end = mean + scale_max*u;
+	line.d = 0;
+	return line;
+}
+
+namespace {
+
+//fit through the points whose residual is at most max_residual, all points if residuals is empty
+PoleLine FitLineKept(const std::vector<Eigen::Vector3d> &points, const std::vector<double> &residuals,
+	const double &max_residual) {
+	Eigen::Vector3d mean(0,0,0);
+	double min_z = 2000;
+	double max_z = -2000;
+	int n = 0;
+	for (int j = 0; j < points.size(); j++) {
+		if (!residuals.empty() && residuals[j] > max_residual) continue;
+		const Eigen::Vector3d &temp = points[j];
+		mean += temp;
+		if (temp.z() < min_z) min_z = temp.z();
+		if (temp.z() > max_z) max_z = temp.z();
+		n++;
+	}
+	mean /= n;
+	Eigen::Matrix3d matrix = Eigen::Matrix3d::Zero();
+	for (int j = 0; j < points.size(); j++) {
+		if (!residuals.empty() && residuals[j] > max_residual) continue;
+		const Eigen::Vector3d temp = points[j] - mean;
+		matrix.noalias() += temp*temp.transpose();
+	}
+	return LineFromMoments(mean, matrix / n, min_z, max_z);
+}
+
+}	//namespace
+
+PoleLine FitLineTrimmed(const std::vector<Eigen::Vector3d> &points, const double &keep_fraction) {
+	const int n = points.size();
+	const int n_keep = std::max(2, std::min(n, (int)std::ceil(keep_fraction * n)));
+	std::vector<double> residuals;
+	PoleLine line = FitLineKept(points, residuals, 0);
+	if (n_keep >= n) return line;
+	residuals.resize(n);
+	std::vector<double> sorted(n);
+	double last_trimmed_sum = -1;
+	for (int iteration = 0; iteration < 10; iteration++) {	//concentration steps, converge in a few
+		for (int j = 0; j < n; j++) {	//squared distance to line
+			const Eigen::Vector3d d = points[j] - line.p;
+			const double along = d.dot(line.u);
+			residuals[j] = d.squaredNorm() - along * along;
+		}
+		sorted = residuals;
+		std::nth_element(sorted.begin(), sorted.begin() + n_keep - 1, sorted.end());
+		const double max_residual = sorted[n_keep - 1];
+		double trimmed_sum = 0;
+		for (int j = 0; j < n_keep; j++) trimmed_sum += sorted[j];
+		//every step lowers the trimmed sum until the kept set stops changing
+		if (last_trimmed_sum >= 0 && trimmed_sum >= last_trimmed_sum * (1 - 1e-6)) break;
+		last_trimmed_sum = trimmed_sum;
+		line = FitLineKept(points, residuals, max_residual);
+	}
+	return line;
+}
+
+FindPoles::FindPoles(const std::vector<Eigen::Vector3d> &cloud, const ClusterMethod &method)
+	: cloud_(cloud), method_(method), pool_(0), keep_fraction_(1.0), diameter_method_(kDiameterExtent) {}
+
+void FindPoles::SetThreadPool(ThreadPool *pool) {
+	pool_ = pool;
+}
+
+void FindPoles::SetLineFitKeep(const double &keep_fraction) {
+	keep_fraction_ = keep_fraction;
+}
+
+void FindPoles::SetDiameterMethod(const DiameterMethod &method) {
+	diameter_method_ = method;
+}
+
+void FindPoles::ForEachPole(const std::function<void(int)> &task) {
+	if (pool_) pool_->ParallelFor(pole_clouds_.size(), task);
+	else for (int i = 0; i < pole_clouds_.size(); i++) task(i);
+}
+
+void FindPoles::CalcPoles() {
+	FindPoleClouds();
+	FilterPoleClouds();
+	FitLines();
+	GetDiameter();
+}
+
+std::vector<PoleLine> FindPoles::GetPoles() const {
+	return lines_;
+}
+
+void FindPoles::FindPoleClouds() {
+	if (method_ == kClusterSeed) {
+		FindPoleCloudsSeed();
+		return;
+	}
+	std::vector<int> labels;
+	const int n_clusters = GridCluster(cloud_, 0.5, &labels);
+	std::vector<int> sizes(n_clusters, 0);
+	for (int i = 0; i < labels.size(); i++) sizes[labels[i]]++;
+	pole_clouds_.resize(n_clusters);
+	for (int j = 0; j < n_clusters; j++) pole_clouds_[j].reserve(sizes[j]);
+	for (int i = 0; i < cloud_.size(); i++) pole_clouds_[labels[i]].push_back(cloud_[i]);
+}
+
+//a point can end up in several pole clouds if their first points are close
+void FindPoles::FindPoleCloudsSeed() {
+	for (int i = 0; i < cloud_.size(); i++) {
+		const Eigen::Vector3d &temp_point = cloud_[i];
+		bool has_pole = false;
+		for (int j = 0; j < pole_clouds_.size(); j++) {	//find pole for current point
+			const double px = pole_clouds_[j][0].x();
+			const double py = pole_clouds_[j][0].y();
+			const double dist = (px-temp_point.x())*(px-temp_point.x()) + (py-temp_point.y())*(py-temp_point.y());
+			if(dist < 0.25) {
+				has_pole = true;
+				pole_clouds_[j].push_back(temp_point);
+			}
+		}
+		if (!has_pole) {	//make new pole if point doesnt fit
+			pole_clouds_.push_back(std::vector<Eigen::Vector3d>(1, temp_point));
+		}
+	}
+}
+
+void FindPoles::FilterPoleClouds() {
+	int count = 0;
+	int n = pole_clouds_.size();
+	if (n == 0) return;
+	for(int i = 0; i < n; i++) {
+		count += pole_clouds_[i].size();
+	}
+	count /= n;
+	Log(kLogInfo, "Average %d points", count);
+	for (int i = 0; i < pole_clouds_.size(); i++) {
+		if ((double)pole_clouds_[i].size()/count < 0.1) {
+			Log(kLogInfo, "Discarded pole %d with %lu points", i, pole_clouds_[i].size());
+			pole_clouds_.erase(pole_clouds_.begin()+i);
+			i--;
+		}
+		else Log(kLogInfo, "Kept pole %d with %lu points", i, pole_clouds_[i].size());
+	}
+}
+
+void FindPoles::FitLines() {
+	lines_.resize(pole_clouds_.size());
+	ForEachPole([this](int i) {FitLine(i);});
+}
+
+void FindPoles::FitLine(const int &i) {
+	lines_[i] = FitLineTrimmed(pole_clouds_[i], keep_fraction_);	//a plain fit if all points are kept
+}
+
+void FindPoles::GetDiameter() {
+	ForEachPole([this](int i) {EstimateDiameter(i);});
+}
+
+void FindPoles::EstimateDiameter(const int &i) {
+	const std::vector<Eigen::Vector3d> &points = pole_clouds_[i];
+	PoleLine &line = lines_[i];
+	const int n = points.size();
+	//points relative to the base point as float arrays, the projection below then vectorizes
+	Eigen::ArrayXf x(n), y(n), z(n);
+	for (int j = 0; j < n; j++) {
+		x[j] = points[j].x() - line.p.x();
+		y[j] = points[j].y() - line.p.y();
+		z[j] = points[j].z() - line.p.z();
+	}
+	//lateral axis seen from the laser, projected on the normal plane of the pole direction
+	const double theta = atan2(line.p.y(), line.p.x());
+	const Eigen::Vector3d r(-sin(theta), cos(theta), 0);
+	const Eigen::Vector3f lateral_axis = (r - line.u.dot(r) * line.u).normalized().cast<float>();
+	const Eigen::Vector3f u = line.u.cast<float>();
+	const Eigen::ArrayXf lateral = lateral_axis.x() * x + lateral_axis.y() * y + lateral_axis.z() * z;
+	const Eigen::ArrayXf height = u.x() * x + u.y() * y + u.z() * z;
+	if (diameter_method_ == kDiameterCircle) {
+		const Eigen::Vector3d b(cos(theta), sin(theta), 0);	//second axis of the normal plane
+		const Eigen::Vector3f radial_axis = (b - line.u.dot(b) * line.u).normalized().cast<float>();
+		const Eigen::ArrayXf radial = radial_axis.x() * x + radial_axis.y() * y + radial_axis.z() * z;
+		line.d = CircleDiameter(lateral, radial);
+	}
+	else {	//lateral extent in bands of equal height instead of sorting by z
+		const int n_bands = std::max(1, n / kBandPoints);
+		const float min_height = height.minCoeff();
+		const float span = height.maxCoeff() - min_height;
+		const float scale = span > 0 ? n_bands / span : 0;
+		std::vector<float> band_min(n_bands, 2000), band_max(n_bands, -2000);
+		std::vector<int> band_count(n_bands, 0);
+		for (int j = 0; j < n; j++) {
+			const int band = std::min(n_bands - 1, (int)((height[j] - min_height) * scale));
+			band_min[band] = std::min(band_min[band], lateral[j]);
+			band_max[band] = std::max(band_max[band], lateral[j]);
+			band_count[band]++;
+		}
+		double sum = 0, sum_all = 0;
+		int used = 0, used_all = 0;
+		for (int b = 0; b < n_bands; b++) {
+			if (band_count[b] == 0) continue;
+			sum_all += band_max[b] - band_min[b];
+			used_all++;
+			if (band_count[b] < kMinBandPoints) continue;
+			sum += band_max[b] - band_min[b];
+			used++;
+		}
+		line.d = used > 0 ? sum / used : (used_all > 0 ? sum_all / used_all : 0);
+	}
+	Log(kLogInfo, "diameter of pole %d \t%f", i, line.d);
+}
+
+}	//namespace localization_core
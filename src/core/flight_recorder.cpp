@@ -0,0 +1,103 @@
+#include "localization/core/flight_recorder.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace localization_core {
+
+namespace {
+
+static_assert(sizeof(FlightEvent) == 64, "flight events are one cache line");
+
+const FlightEventInfo kEventInfo[kFlightEventTypes] = {
+	{"odometry", 0, "right_um left_um"},
+	{"association", "pole", "scan_x scan_y cost"},
+	{"assigned", "assigned", "scan_points poles"},
+	{"innovation", "visible_pole", "map_x map_y nu_x nu_y r_x r_y"},
+	{"pose", "visible_poles", "x y theta p_xx p_xy p_xt p_yy p_yt p_tt filter_us"},
+	{"poles", "visible", "poles"},
+};
+
+FlightEvent ring[kFlightRecorderSize];
+uint64_t recorded = 0;	//only accessed atomically
+char crash_path[512];
+
+uint64_t ClockNs(const clockid_t &clock) {
+	timespec now;
+	clock_gettime(clock, &now);
+	return uint64_t(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+bool WriteAll(const int &fd, const void *data, std::size_t size) {
+	const char *bytes = static_cast<const char*>(data);
+	while (size > 0) {
+		const ssize_t n = write(fd, bytes, size);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		bytes += n;
+		size -= n;
+	}
+	return true;
+}
+
+void CrashHandler(int signal) {
+	DumpFlightRecorder(crash_path);
+	raise(signal);	//default action again, delivered when the handler returns
+}
+
+}	//namespace
+
+const FlightEventInfo* GetFlightEventInfo(const int &type) {
+	return type >= 0 && type < kFlightEventTypes ? &kEventInfo[type] : 0;
+}
+
+uint64_t FlightClockNs() {
+	return ClockNs(CLOCK_MONOTONIC);
+}
+
+void FlightRecordValues(const FlightEventType &type, const int32_t &id, const float *values, const int &count) {
+	const uint64_t index = __atomic_fetch_add(&recorded, 1, __ATOMIC_RELAXED);
+	FlightEvent &event = ring[index & (kFlightRecorderSize - 1)];
+	__atomic_store_n(&event.seq, 0, __ATOMIC_RELAXED);	//torn until seq is set again
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	event.time_ns = ClockNs(CLOCK_MONOTONIC);
+	event.type = type;
+	event.id = id;
+	event.count = std::min(count, kFlightValues);
+	for (int i = 0; i < event.count; i++) event.values[i] = values[i];
+	__atomic_store_n(&event.seq, index + 1, __ATOMIC_RELEASE);
+}
+
+bool DumpFlightRecorder(const char *path) {
+	FlightDumpHeader header;
+	header.magic = kFlightDumpMagic;
+	header.version = kFlightDumpVersion;
+	header.event_size = sizeof(FlightEvent);
+	header.capacity = kFlightRecorderSize;
+	header.recorded = __atomic_load_n(&recorded, __ATOMIC_ACQUIRE);
+	header.steady_ns = ClockNs(CLOCK_MONOTONIC);
+	header.wall_ns = ClockNs(CLOCK_REALTIME);
+	const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return false;
+	bool ok = WriteAll(fd, &header, sizeof(header)) && WriteAll(fd, ring, sizeof(ring));
+	const uint64_t recorded_after = __atomic_load_n(&recorded, __ATOMIC_ACQUIRE);	//slots claimed during the copy
+	ok = ok && WriteAll(fd, &recorded_after, sizeof(recorded_after));
+	return close(fd) == 0 && ok;
+}
+
+void DumpFlightRecorderOnCrash(const std::string &path) {
+	std::strncpy(crash_path, path.c_str(), sizeof(crash_path) - 1);
+	struct sigaction action;
+	std::memset(&action, 0, sizeof(action));
+	action.sa_handler = CrashHandler;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESETHAND;	//a crash in the handler ends the process
+	const int signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+	for (int i = 0; i < 5; i++) sigaction(signals[i], &action, 0);
+}
+
+}	//namespace localization_core
@@ -0,0 +1,120 @@
+#include "localization/core/get_pose.h"
+#include "localization/core/log.h"
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+
+namespace localization_core {
+
+namespace {
+
+//Huber cost of pose; also the weighted normal equations if normal is given
+double Linearize(const PoleStore &poles, const PoseFitParams &params, const Pose2D &pose, Eigen::Matrix3d *normal,
+	Eigen::Vector3d *gradient) {
+	const double c = cos(pose.theta), s = sin(pose.theta);
+	const double delta = params.huber_delta;
+	double cost = 0;
+	if (normal) {
+		normal->setZero();
+		gradient->setZero();
+	}
+	poles.ForEachVisible([&](const int &i) {
+		const double dx = poles.x()[i] - pose.x, dy = poles.y()[i] - pose.y;
+		const double h_x = c*dx + s*dy, h_y = -s*dx + c*dy;	//expected laser coordinates
+		const Eigen::Vector2d r(h_x - poles.laser_x()[i], h_y - poles.laser_y()[i]);
+		const double norm = r.norm();
+		cost += norm <= delta ? 0.5*norm*norm : delta*(norm - 0.5*delta);
+		if (!normal) return;
+		const double weight = norm <= delta ? 1 : delta/norm;
+		Eigen::Matrix<double, 2, 3> jacobi;
+		jacobi <<
+			-c, -s, h_y,
+			s, -c, -h_x;
+		*normal += weight*jacobi.transpose()*jacobi;
+		*gradient += weight*jacobi.transpose()*r;
+	});
+	return cost;
+}
+
+}	//namespace
+
+Pose2D GetPose(const PoleStore &poles) {
+	const int max_iterations = 100;	//guards against oscillation
+	const int n = poles.CountVisible();
+	Eigen::Vector2d x(0,0), x_old(2000,2000);
+	Eigen::MatrixXd jacobi(n, 2);
+	Eigen::VectorXd f_x(n);
+	Eigen::VectorXd c(n);
+	for (int iteration = 0; (x_old - x).norm() > 0.01 && iteration < max_iterations; iteration++) {
+		x_old = x;
+		int row = 0;
+		poles.ForEachVisible([&](const int &i) {
+			Eigen::Vector2d x_p( poles.x()[i], poles.y()[i]);
+			Eigen::Vector2d x_m( poles.laser_x()[i], poles.laser_y()[i]);
+			jacobi(row, 0) = 2 * x_old.x() - 2 * x_p.x();
+			jacobi(row, 1) = 2 * x_old.y() - 2 * x_p.y();
+			f_x(row) = (x_p.x() - x_old.x() ) * (x_p.x() - x_old.x() ) + (x_p.y() - x_old.y() ) * (x_p.y() - x_old.y() );
+			c(row) = x_m.x() * x_m.x() + x_m.y() * x_m.y();
+			row++;
+		});
+		x += jacobi.colPivHouseholderQr().solve(c - f_x);
+	}
+	Log(kLogDebug, "initial pos [%f %f]", x.x(), x.y() );
+	double theta_sin = 0, theta_cos = 0;
+	poles.ForEachVisible([&](const int &i) {	//average over all results on the circle, they may wrap at pi
+		Eigen::Vector2d x_p( poles.x()[i], poles.y()[i]);
+		Eigen::Vector2d x_m( poles.laser_x()[i], poles.laser_y()[i]);
+		const double cur_theta = atan2( x_p.y() - x.y(), x_p.x() - x.x() ) - atan2( x_m.y(), x_m.x() );
+		Log(kLogDebug, "cur_theta %f", cur_theta);
+		theta_sin += sin(cur_theta);
+		theta_cos += cos(cur_theta);
+	});
+	const double theta = atan2(theta_sin, theta_cos);
+	Log(kLogDebug, "theta %f", theta);
+	Pose2D pose;
+	pose.x = x.x();
+	pose.y = x.y();
+	pose.theta = theta;
+	return pose;
+}
+
+bool FitPose(const PoleStore &poles, const PoseFitParams &params, Pose2D *pose, Eigen::Matrix3d *covariance) {
+	if (poles.CountVisible() < 2) return false;
+	Pose2D current = *pose;
+	Eigen::Matrix3d normal;
+	Eigen::Vector3d gradient;
+	double cost = Linearize(poles, params, current, &normal, &gradient);
+	double damping = 1e-3;
+	int iteration = 0;
+	for (; iteration < params.max_iterations; iteration++) {
+		Eigen::Matrix3d damped = normal;
+		damped.diagonal() *= 1 + damping;
+		const Eigen::Vector3d step = -damped.ldlt().solve(gradient);
+		if (!step.allFinite()) return false;
+		Pose2D next = current;
+		next.x += step[0];
+		next.y += step[1];
+		next.theta += step[2];
+		NormalizeAngle(next.theta);
+		const double next_cost = Linearize(poles, params, next, 0, 0);
+		if (next_cost <= cost) {	//accept and move towards Gauss-Newton
+			current = next;
+			cost = Linearize(poles, params, current, &normal, &gradient);
+			damping = std::max(damping / 10, 1e-9);
+			if (step.norm() < 1e-9) break;
+		}
+		else {	//reject and move towards gradient descent
+			damping *= 10;
+			if (damping > 1e9) break;
+		}
+	}
+	const Eigen::Matrix3d fit_covariance = params.scan_covariance * normal.inverse();
+	if (!std::isfinite(current.x) || !std::isfinite(current.y) || !std::isfinite(current.theta) ||
+		!fit_covariance.allFinite()) return false;
+	Log(kLogDebug, "pose fit after %d iterations, cost %f", iteration, cost);
+	*pose = current;
+	*covariance = fit_covariance;
+	return true;
+}
+
+}	//namespace localization_core
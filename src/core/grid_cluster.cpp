@@ -0,0 +1,136 @@
+#include "localization/core/grid_cluster.h"
+#include "localization/core/grid_index.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+
+namespace localization_core {
+
+namespace {
+
+struct Cell {
+	int begin;	//range of the cell's points in the sorted arrays
+	int end;
+	double min_x, max_x, min_y, max_y;
+};
+
+int Find(std::vector<int> *parent, int i) {
+	while ((*parent)[i] != i) {
+		(*parent)[i] = (*parent)[(*parent)[i]];	//path halving
+		i = (*parent)[i];
+	}
+	return i;
+}
+
+void Union(std::vector<int> *parent, const int &a, const int &b) {
+	const int root_a = Find(parent, a);
+	const int root_b = Find(parent, b);
+	if (root_a != root_b) (*parent)[std::max(root_a, root_b)] = std::min(root_a, root_b);
+}
+
+//true if any point of cell a is closer than radius to any point of cell b
+bool CellsTouch(const Cell &a, const Cell &b, const std::vector<double> &x, const std::vector<double> &y,
+	const double &radius_sq) {
+	const double gap_x = std::max(0.0, std::max(a.min_x - b.max_x, b.min_x - a.max_x));
+	const double gap_y = std::max(0.0, std::max(a.min_y - b.max_y, b.min_y - a.max_y));
+	if (gap_x * gap_x + gap_y * gap_y >= radius_sq) return false;	//bounding boxes too far apart
+	const double span_x = std::max(a.max_x, b.max_x) - std::min(a.min_x, b.min_x);
+	const double span_y = std::max(a.max_y, b.max_y) - std::min(a.min_y, b.min_y);
+	if (span_x * span_x + span_y * span_y < radius_sq) return true;	//every pair is close enough
+	for (int i = a.begin; i < a.end; i++) {
+		for (int j = b.begin; j < b.end; j++) {
+			const double dx = x[i] - x[j];
+			const double dy = y[i] - y[j];
+			if (dx * dx + dy * dy < radius_sq) return true;
+		}
+	}
+	return false;
+}
+
+}	//namespace
+
+int GridCluster(const std::vector<Eigen::Vector3d> &points, const double &radius, std::vector<int> *labels) {
+	const int n = points.size();
+	labels->assign(n, -1);
+	if (n == 0) return 0;
+	const double cell_size = radius / std::sqrt(2.0);
+	//bin the points, a hash map finds the cell of a point and a counting sort groups the points by cell
+	std::vector<int> cell_of_point(n);
+	std::vector<Cell> cells;
+	std::vector<int64_t> cell_ix, cell_iy;
+	std::unordered_map<uint64_t, int> cell_of_key;
+	uint64_t last_key = 0;
+	int last_cell = -1;
+	for (int i = 0; i < n; i++) {
+		const double px = points[i].x();
+		const double py = points[i].y();
+		const int64_t ix = GridCell(px, cell_size);
+		const int64_t iy = GridCell(py, cell_size);
+		const uint64_t key = GridCellKey(ix, iy);
+		if (last_cell < 0 || key != last_key) {	//consecutive scan points often share a cell
+			std::unordered_map<uint64_t, int>::iterator found = cell_of_key.find(key);
+			if (found == cell_of_key.end()) {
+				found = cell_of_key.insert(std::make_pair(key, (int)cells.size())).first;
+				Cell cell;
+				cell.begin = cell.end = 0;
+				cell.min_x = cell.max_x = px;
+				cell.min_y = cell.max_y = py;
+				cells.push_back(cell);
+				cell_ix.push_back(ix);
+				cell_iy.push_back(iy);
+			}
+			last_key = key;
+			last_cell = found->second;
+		}
+		Cell &cell = cells[last_cell];
+		cell.end++;	//counts the points for now
+		cell.min_x = std::min(cell.min_x, px);
+		cell.max_x = std::max(cell.max_x, px);
+		cell.min_y = std::min(cell.min_y, py);
+		cell.max_y = std::max(cell.max_y, py);
+		cell_of_point[i] = last_cell;
+	}
+	int offset = 0;
+	for (int c = 0; c < cells.size(); c++) {
+		cells[c].begin = offset;
+		offset += cells[c].end;
+		cells[c].end = cells[c].begin;
+	}
+	std::vector<double> x(n), y(n);
+	for (int i = 0; i < n; i++) {
+		Cell &cell = cells[cell_of_point[i]];
+		x[cell.end] = points[i].x();
+		y[cell.end] = points[i].y();
+		cell.end++;
+	}
+	//join neighbouring cells, points up to two cells apart can be closer than radius
+	std::vector<int> parent(cells.size());
+	for (int c = 0; c < cells.size(); c++) parent[c] = c;
+	const double radius_sq = radius * radius;
+	for (int c = 0; c < cells.size(); c++) {
+		for (int dy = 0; dy <= 2; dy++) {
+			for (int dx = -2; dx <= 2; dx++) {
+				if (dy == 0 && dx <= 0) continue;	//every pair of cells only once
+				if (std::abs(dx) == 2 && dy == 2) continue;	//corners are at least radius apart
+				std::unordered_map<uint64_t, int>::const_iterator other =
+					cell_of_key.find(GridCellKey(cell_ix[c] + dx, cell_iy[c] + dy));
+				if (other == cell_of_key.end()) continue;
+				if (Find(&parent, c) == Find(&parent, other->second)) continue;
+				if (CellsTouch(cells[c], cells[other->second], x, y, radius_sq)) Union(&parent, c, other->second);
+			}
+		}
+	}
+	//number the clusters in the order of their first point
+	std::vector<int> label_of_root(cells.size(), -1);
+	int n_clusters = 0;
+	for (int i = 0; i < n; i++) {
+		const int root = Find(&parent, cell_of_point[i]);
+		if (label_of_root[root] < 0) label_of_root[root] = n_clusters++;
+		(*labels)[i] = label_of_root[root];
+	}
+	return n_clusters;
+}
+
+}	//namespace localization_core
@@ -0,0 +1,160 @@
+#include "localization/core/kalman.h"
+#include "localization/core/flight_recorder.h"
+#include "localization/core/kalman_kernels.h"
+#include <cmath>
+
+namespace localization_core {
+
+void PredictPose(const double &delta_s, const double &time_scale_pose, const double &delta_theta,
+	const double &time_scale_imu, const bool &translate, const FilterParams &params,
+	Eigen::Vector3d *state, Eigen::Matrix3d *covariance) {
+	if (params.single_precision) {
+		Eigen::Vector3f state_f = state->cast<float>();
+		Eigen::Matrix3f covariance_f = covariance->cast<float>();
+		PredictKernel<float>(delta_s, time_scale_pose, delta_theta, time_scale_imu, translate, params.k_s, params.k_th,
+			&state_f, &covariance_f);
+		*state = state_f.cast<double>();
+		*covariance = covariance_f.cast<double>();
+	}
+	else {
+		PredictKernel<double>(delta_s, time_scale_pose, delta_theta, time_scale_imu, translate, params.k_s, params.k_th,
+			state, covariance);
+	}
+}
+
+namespace {
+
+void PackVisible(const PoleStore &poles, PackedPoles<double> *packed) {
+	packed->Clear();
+	poles.ForEachVisible([&](const int &i) {
+		packed->Add(poles.x()[i], poles.y()[i], poles.laser_x()[i], poles.laser_y()[i]);
+	});
+}
+
+//residuals at the predicted pose, the measurement model was evaluated there by the update
+template <typename T>
+void RecordInnovations(const PackedPoles<T> &poles) {
+	for (int i = 0; i < poles.size(); i++) {
+		FlightRecord(kFlightInnovation, i, poles.map_x[i], poles.map_y[i], poles.z_x[i] - poles.h_x[i],
+			poles.z_y[i] - poles.h_y[i], poles.r_x[i], poles.r_y[i]);
+	}
+}
+
+}	//namespace
+
+void PoleMeasurements::Pack(const PoleStore &poles) {
+	PackVisible(poles, &poles_);
+}
+
+int PoleMeasurements::size() const {
+	return poles_.size();
+}
+
+void UpdatePose(PoleMeasurements *measurements, const FilterParams &params,
+	Eigen::Vector3d *state, Eigen::Matrix3d *covariance) {
+	if (params.single_precision) {
+		measurements->poles_f_.AssignInputs(measurements->poles_);
+		Eigen::Vector3f state_f = state->cast<float>();
+		Eigen::Matrix3f covariance_f = covariance->cast<float>();
+		UpdateKernel<float, 1>(&measurements->poles_f_, params.scan_covariance, &state_f, &covariance_f);
+		*state = state_f.cast<double>();
+		*covariance = covariance_f.cast<double>();
+		RecordInnovations(measurements->poles_f_);
+	}
+	else {
+		UpdateKernel<double, 1>(&measurements->poles_, params.scan_covariance, state, covariance);
+		RecordInnovations(measurements->poles_);
+	}
+}
+
+void UpdatePose(const PoleStore &poles, const FilterParams &params,
+	Eigen::Vector3d *state, Eigen::Matrix3d *covariance) {
+	PoleMeasurements measurements;
+	measurements.Pack(poles);
+	UpdatePose(&measurements, params, state, covariance);
+}
+
+void UpdatePoseBatch(const PoleStore &poles, const FilterParams &params,
+	Eigen::Vector3d *state, Eigen::Matrix3d *covariance) {
+	PackedPoles<double> visible_poles;
+	PackVisible(poles, &visible_poles);
+	if (visible_poles.size() == 0) return;	//dont make scan step if no poles visible
+	Eigen::VectorXd h_x = EstimateReferencePoint(visible_poles, *state);
+	Eigen::MatrixXd H = EstimateJacobi(visible_poles, *state);
+	Eigen::MatrixXd R = ErrorMatrix(visible_poles, *state, params.scan_covariance);
+	Eigen::VectorXd z = CalculateMeasuredPoints(visible_poles);
+	Eigen::MatrixXd Sigma = H*(*covariance)*H.transpose()+R;
+	Eigen::MatrixXd K = (*covariance)*H.transpose()*Sigma.inverse();	//!!!inverse bad?!
+	Eigen::VectorXd nu = z-h_x;
+	*state += K*nu;	//update state with measurement
+	*covariance -= K*Sigma*K.transpose();	//update covariance with measurement
+}
+
+Eigen::Matrix3d StateJacobi(const double &ds, const double &dth, const double &theta) {
+	Eigen::Matrix3d f_x;
+	f_x << 
+		1, 0, -ds*sin(theta+dth/2),
+		0, 1, ds*cos(theta + dth/2),
+		0, 0, 1;
+	return f_x;
+}
+
+Eigen::Matrix<double, 3, 2> InputJacobi(const double &ds, const double &dth, const double &theta, const double &b) {
+	Eigen::Matrix<double, 3, 2> f_u;
+	f_u << 
+		0.5*cos(theta + dth/2)-ds/(2*b)*sin(theta + dth/2), 0.5*cos(theta + dth/2)+ds/(2*b)*sin(theta + dth/2),
+		0.5*sin(theta + dth/2)+ds/(2*b)*cos(theta + dth/2), 0.5*sin(theta + dth/2)-ds/(2*b)*cos(theta + dth/2),
+		1/b, 1/b;
+	return f_u;
+}
+
+Eigen::VectorXd EstimateReferencePoint(const PackedPoles<double> &visible_poles, const Eigen::Vector3d &state) {
+	Eigen::VectorXd h_x(visible_poles.size()*2);
+	for (int i = 0; i < visible_poles.size(); i++) {
+		const double xp = visible_poles.map_x[i];
+		const double yp = visible_poles.map_y[i];
+		h_x[2*i] = cos(state[2])*(xp-state[0])+sin(state[2])*(yp-state[1]);
+		h_x[2*i+1] = -sin(state[2])*(xp-state[0])+cos(state[2])*(yp-state[1]);
+	}
+	return h_x;
+}
+
+Eigen::MatrixXd EstimateJacobi(const PackedPoles<double> &visible_poles, const Eigen::Vector3d &state) {
+	Eigen::MatrixXd H(visible_poles.size()*2, 3);
+	for (int i = 0; i < visible_poles.size(); i++) {
+		const double xp = visible_poles.map_x[i];
+		const double yp = visible_poles.map_y[i];
+		H(2*i,0) = -cos(state[2]);
+		H(2*i,1) = -sin(state[2]);
+		H(2*i,2) = -sin(state[2])*(xp-state[0])+cos(state[2])*(yp-state[1]);
+		H(2*i+1,0) = sin(state[2]);
+		H(2*i+1,1) = -cos(state[2]);
+		H(2*i+1,2) = -cos(state[2])*(xp-state[0])-sin(state[2])*(yp-state[1]);
+	}
+	return H;
+}
+
+Eigen::MatrixXd ErrorMatrix(const PackedPoles<double> &visible_poles, const Eigen::Vector3d &state,
+	const double &scan_covariance) {
+	Eigen::MatrixXd R = Eigen::MatrixXd::Zero(visible_poles.size()*2,visible_poles.size()*2);
+	for (int i = 0; i < visible_poles.size(); i++) {
+		const double xp = visible_poles.map_x[i];
+		const double yp = visible_poles.map_y[i];
+		const double vis_angle = atan2(yp - state[2], xp - state[1]);
+		R(2*i,2*i) = scan_covariance * cos(vis_angle) * cos(vis_angle);
+		R(2*i+1,2*i+1) = scan_covariance * sin(vis_angle) * sin(vis_angle);
+		//TODO: maybe add variance due to limited angular resolution. Might be fine without due to averaging
+	}
+	return R;
+}
+
+Eigen::VectorXd CalculateMeasuredPoints(const PackedPoles<double> &visible_poles) {
+	Eigen::VectorXd z(2*visible_poles.size());
+	for (int i = 0; i < visible_poles.size(); i++) {
+		z[2*i] = visible_poles.z_x[i];
+		z[2*i+1] = visible_poles.z_y[i];
+	}
+	return z;
+}
+
+}	//namespace localization_core
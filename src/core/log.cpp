@@ -0,0 +1,31 @@
+#include "localization/core/log.h"
+#include <cstdarg>
+#include <cstdio>
+
+namespace localization_core {
+
+namespace {
+
+void StderrHandler(const LogLevel &level, const char *message) {
+	static const char* prefix[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+	std::fprintf(stderr, "[%s] %s\n", prefix[level], message);
+}
+
+LogHandler handler = StderrHandler;
+
+}	//namespace
+
+void SetLogHandler(LogHandler new_handler) {
+	handler = new_handler ? new_handler : StderrHandler;
+}
+
+void Log(const LogLevel &level, const char *format, ...) {
+	char message[512];
+	va_list args;
+	va_start(args, format);
+	std::vsnprintf(message, sizeof(message), format, args);
+	va_end(args);
+	handler(level, message);
+}
+
+}	//namespace localization_core
@@ -0,0 +1,155 @@
+#include "localization/core/map_file.h"
+#include "localization/core/log.h"
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace localization_core {
+
+namespace {
+
+struct MapHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;
+	uint32_t checksum;	//FNV-1a of the records
+	double initial_pose[3];	//x, y, theta
+};
+
+struct MapRecord {
+	double p[3];
+	double u[3];
+	double end[3];
+	double d;
+};
+
+uint32_t Checksum(const void *data, const std::size_t &size) {
+	const unsigned char *bytes = static_cast<const unsigned char*>(data);
+	uint32_t hash = 2166136261u;
+	for (std::size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 16777619u;
+	return hash;
+}
+
+void ToArray(const Eigen::Vector3d &v, double *a) {
+	a[0] = v.x(); a[1] = v.y(); a[2] = v.z();
+}
+
+//finite values, unit direction and positive diameter, as every fit that converged gives
+bool ValidRecord(const MapRecord &record) {
+	for (int k = 0; k < 3; k++) {
+		if (!std::isfinite(record.p[k]) || !std::isfinite(record.u[k]) || !std::isfinite(record.end[k])) return false;
+	}
+	const double norm = std::sqrt(record.u[0] * record.u[0] + record.u[1] * record.u[1] + record.u[2] * record.u[2]);
+	return std::abs(norm - 1) < 1e-6 && record.d > 0;
+}
+
+//index of the first invalid record, count if all are valid
+uint32_t FirstInvalid(const MapRecord *records, const uint32_t &count) {
+	for (uint32_t i = 0; i < count; i++) if (!ValidRecord(records[i])) return i;
+	return count;
+}
+
+}	//namespace
+
+bool SaveMap(const std::string &path, const PoleStore &poles, const Pose2D &initial_pose) {
+	std::vector<MapRecord> records(poles.size());
+	for (int i = 0; i < poles.size(); i++) {
+		const PoleLine line = poles.line(i);
+		ToArray(line.p, records[i].p);
+		ToArray(line.u, records[i].u);
+		ToArray(line.end, records[i].end);
+		records[i].d = line.d;
+	}
+	MapHeader header;
+	header.magic = kMapFileMagic;
+	header.version = kMapFileVersion;
+	header.count = records.size();
+	header.checksum = Checksum(records.data(), records.size() * sizeof(MapRecord));
+	header.initial_pose[0] = initial_pose.x;
+	header.initial_pose[1] = initial_pose.y;
+	header.initial_pose[2] = initial_pose.theta;
+	const std::string temp = path + ".tmp";
+	FILE *file = std::fopen(temp.c_str(), "wb");
+	if (!file) {
+		Log(kLogError, "could not write map file %s: %s", temp.c_str(), std::strerror(errno));
+		return false;
+	}
+	bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+	if (!records.empty()) ok = ok && std::fwrite(records.data(), sizeof(MapRecord), records.size(), file) == records.size();
+	ok = std::fclose(file) == 0 && ok;
+	if (!ok || std::rename(temp.c_str(), path.c_str()) != 0) {
+		Log(kLogError, "could not write map file %s: %s", path.c_str(), std::strerror(errno));
+		std::remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool LoadMap(const std::string &path, PoleStore *poles, Pose2D *initial_pose) {
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		Log(kLogInfo, "no map file %s: %s", path.c_str(), std::strerror(errno));
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < sizeof(MapHeader)) {
+		Log(kLogWarn, "map file %s is truncated", path.c_str());
+		close(fd);
+		return false;
+	}
+	void *data = mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);	//the mapping stays valid
+	if (data == MAP_FAILED) {
+		Log(kLogWarn, "could not map %s: %s", path.c_str(), std::strerror(errno));
+		return false;
+	}
+	const MapHeader &header = *static_cast<const MapHeader*>(data);
+	const MapRecord *records = reinterpret_cast<const MapRecord*>(static_cast<const char*>(data) + sizeof(MapHeader));
+	bool ok = false;
+	uint32_t invalid;
+	if (header.magic != kMapFileMagic) {
+		Log(kLogWarn, "%s is no map file or has another byte order", path.c_str());
+	}
+	else if (header.version != kMapFileVersion) {
+		Log(kLogWarn, "map file %s has version %u, expected %u", path.c_str(), header.version, kMapFileVersion);
+	}
+	else if (info.st_size != sizeof(MapHeader) + header.count * sizeof(MapRecord)) {
+		Log(kLogWarn, "map file %s has %ld bytes for %u poles", path.c_str(), (long)info.st_size, header.count);
+	}
+	else if (Checksum(records, header.count * sizeof(MapRecord)) != header.checksum) {
+		Log(kLogWarn, "map file %s is corrupt", path.c_str());
+	}
+	else if ((invalid = FirstInvalid(records, header.count)) < header.count) {
+		Log(kLogWarn, "map file %s has an invalid pole %u: not finite, no unit direction or no diameter",
+			path.c_str(), invalid);
+	}
+	else if (!std::isfinite(header.initial_pose[0]) || !std::isfinite(header.initial_pose[1])
+		|| !std::isfinite(header.initial_pose[2])) {
+		Log(kLogWarn, "map file %s has no finite initial pose", path.c_str());
+	}
+	else {
+		poles->Clear();
+		for (int i = 0; i < header.count; i++) {
+			PoleLine line;
+			line.p = Eigen::Vector3d(records[i].p[0], records[i].p[1], records[i].p[2]);
+			line.u = Eigen::Vector3d(records[i].u[0], records[i].u[1], records[i].u[2]);
+			line.end = Eigen::Vector3d(records[i].end[0], records[i].end[1], records[i].end[2]);
+			line.d = records[i].d;
+			poles->Disappear(poles->Add(line, Eigen::Vector3d::Zero(), 0));	//seen once a scan matches
+		}
+		initial_pose->x = header.initial_pose[0];
+		initial_pose->y = header.initial_pose[1];
+		initial_pose->theta = header.initial_pose[2];
+		ok = true;
+	}
+	munmap(data, info.st_size);
+	return ok;
+}
+
+}	//namespace localization_core
@@ -0,0 +1,185 @@
+#include "localization/core/pole_accumulator.h"
+#include "localization/core/find_poles.h"
+#include "localization/core/grid_index.h"
+#include "localization/core/log.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace localization_core {
+
+namespace {
+
+const double kClusterRadius = 0.5;	//same grouping as FindPoles
+const int kMinBandPoints = 10;	//bands with fewer points underestimate the diameter
+
+uint64_t CellKey(const double &x, const double &y) {
+	return GridCellKey(GridCell(x, kClusterRadius), GridCell(y, kClusterRadius));
+}
+
+}	//namespace
+
+PoleAccumulator::PoleAccumulator(const double &band_height)
+	: band_height_(band_height), last_cluster_(-1), points_(0) {}
+
+void PoleAccumulator::Clear() {
+	clusters_.clear();
+	clusters_of_cell_.clear();
+	last_cluster_ = -1;
+	points_ = 0;
+}
+
+long PoleAccumulator::points() const {
+	return points_;
+}
+
+int PoleAccumulator::FindCluster(const double &x, const double &y) const {
+	if (last_cluster_ >= 0) {
+		const Cluster &last = clusters_[last_cluster_];
+		const double dx = last.seed.x() - x, dy = last.seed.y() - y;
+		if (dx * dx + dy * dy < kClusterRadius * kClusterRadius) return last_cluster_;
+	}
+	//seeds closer than the radius are in the 3x3 neighbourhood of cells
+	int found = -1;
+	const int64_t cell_x = GridCell(x, kClusterRadius), cell_y = GridCell(y, kClusterRadius);
+	for (int cx = -1; cx <= 1; cx++) {
+		for (int cy = -1; cy <= 1; cy++) {
+			std::unordered_map<uint64_t, std::vector<int> >::const_iterator cell =
+				clusters_of_cell_.find(GridCellKey(cell_x + cx, cell_y + cy));
+			if (cell == clusters_of_cell_.end()) continue;
+			for (int i = 0; i < cell->second.size(); i++) {
+				const int c = cell->second[i];
+				const double dx = clusters_[c].seed.x() - x, dy = clusters_[c].seed.y() - y;
+				if (dx * dx + dy * dy < kClusterRadius * kClusterRadius && (found < 0 || c < found)) found = c;
+			}
+		}
+	}
+	return found;
+}
+
+int PoleAccumulator::NewCluster(const double &x, const double &y, const double &z) {
+	Cluster cluster;
+	cluster.seed = Eigen::Vector3d(x, y, z);
+	cluster.sum.setZero();
+	cluster.scatter.setZero();
+	cluster.count = 0;
+	cluster.min_z = z;
+	cluster.max_z = z;
+	const double bearing = atan2(y, x);
+	cluster.cos_bearing = cos(bearing);
+	cluster.sin_bearing = sin(bearing);
+	cluster.first_band = std::floor(z / band_height_);
+	clusters_.push_back(cluster);
+	clusters_of_cell_[CellKey(x, y)].push_back(clusters_.size() - 1);
+	return clusters_.size() - 1;
+}
+
+void PoleAccumulator::Add(const double &x, const double &y, const double &z) {
+	int c = FindCluster(x, y);
+	if (c < 0) c = NewCluster(x, y, z);
+	last_cluster_ = c;
+	points_++;
+	Cluster &cluster = clusters_[c];
+	const Eigen::Vector3d d = Eigen::Vector3d(x, y, z) - cluster.seed;	//relative to the seed to keep precision
+	cluster.count++;
+	cluster.sum += d;
+	cluster.scatter.noalias() += d * d.transpose();
+	cluster.min_z = std::min(cluster.min_z, z);
+	cluster.max_z = std::max(cluster.max_z, z);
+	//lateral offset from the seed, seen from the laser
+	const double lateral = -cluster.sin_bearing * d.x() + cluster.cos_bearing * d.y();
+	const int band = std::floor(z / band_height_);
+	if (band < cluster.first_band) {
+		Band empty = {0, 0, 0};
+		cluster.bands.insert(cluster.bands.begin(), cluster.first_band - band, empty);
+		cluster.first_band = band;
+	}
+	if (band - cluster.first_band >= (int)cluster.bands.size()) {
+		Band empty = {0, 0, 0};
+		cluster.bands.resize(band - cluster.first_band + 1, empty);
+	}
+	Band &slot = cluster.bands[band - cluster.first_band];
+	if (slot.count == 0) slot.min_lateral = slot.max_lateral = lateral;
+	slot.min_lateral = std::min(slot.min_lateral, lateral);
+	slot.max_lateral = std::max(slot.max_lateral, lateral);
+	slot.count++;
+}
+
+//mean lateral extent over the bands, like the 100 point windows of FindPoles
+double PoleAccumulator::Diameter(const Cluster &cluster) const {
+	double sum = 0, sum_all = 0;
+	int n = 0, n_all = 0;
+	for (int b = 0; b < cluster.bands.size(); b++) {
+		const Band &band = cluster.bands[b];
+		if (band.count == 0) continue;
+		const double extent = band.max_lateral - band.min_lateral;
+		sum_all += extent;
+		n_all++;
+		if (band.count < kMinBandPoints) continue;
+		sum += extent;
+		n++;
+	}
+	if (n > 0) return sum / n;
+	return n_all > 0 ? sum_all / n_all : 0;
+}
+
+//clusters with a tenth of the average points are noise, like in FindPoles
+bool PoleAccumulator::Kept(const Cluster &cluster) const {
+	const long average = points_ / (long)clusters_.size();
+	return (double)cluster.count / average >= 0.1;
+}
+
+std::vector<PoleLine> PoleAccumulator::GetPoles() const {
+	std::vector<PoleLine> lines;
+	if (clusters_.empty()) return lines;
+	Log(kLogInfo, "Average %ld points", points_ / (long)clusters_.size());
+	for (int i = 0; i < clusters_.size(); i++) {
+		const Cluster &cluster = clusters_[i];
+		if (!Kept(cluster)) {
+			Log(kLogInfo, "Discarded pole %d with %ld points", i, cluster.count);
+			continue;
+		}
+		Log(kLogInfo, "Kept pole %d with %ld points", i, cluster.count);
+		const Eigen::Vector3d mean = cluster.sum / cluster.count;
+		const Eigen::Matrix3d covariance = cluster.scatter / cluster.count - mean * mean.transpose();
+		PoleLine line = LineFromMoments(cluster.seed + mean, covariance, cluster.min_z, cluster.max_z);
+		line.d = Diameter(cluster);
+		Log(kLogInfo, "diameter of pole %lu \t%f", lines.size(), line.d);
+		lines.push_back(line);
+	}
+	return lines;
+}
+
+void PoleAccumulator::GetStatistics(std::vector<PoleStatistics> *statistics) const {
+	statistics->clear();
+	for (int i = 0; i < clusters_.size(); i++) {
+		const Cluster &cluster = clusters_[i];
+		if (!Kept(cluster)) continue;
+		PoleStatistics pole;
+		pole.count = cluster.count;
+		const Eigen::Vector3d mean = cluster.sum / cluster.count;
+		const Eigen::Matrix3d covariance = cluster.scatter / cluster.count - mean * mean.transpose();
+		Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+		solver.computeDirect(covariance, Eigen::EigenvaluesOnly);	//ascending, the last is along the axis
+		const Eigen::Vector3d spread = solver.eigenvalues().cwiseMax(0);
+		pole.residual = std::sqrt(spread(0) + spread(1));
+		pole.tilt_error = spread(2) > 0 ? pole.residual / std::sqrt(spread(2) * cluster.count) :
+			std::numeric_limits<double>::infinity();
+		double sum = 0, sum_squares = 0;
+		int n = 0;
+		for (int b = 0; b < cluster.bands.size(); b++) {
+			const Band &band = cluster.bands[b];
+			if (band.count < kMinBandPoints) continue;
+			const double extent = band.max_lateral - band.min_lateral;
+			sum += extent;
+			sum_squares += extent * extent;
+			n++;
+		}
+		pole.diameter_variance = n > 1 ? std::max(0.0, (sum_squares - sum * sum / n) / (n - 1)) : 0;
+		pole.diameter_error = n > 1 ? std::sqrt(pole.diameter_variance / n) : std::numeric_limits<double>::infinity();
+		pole.z_coverage = cluster.max_z - cluster.min_z;
+		statistics->push_back(pole);
+	}
+}
+
+}	//namespace localization_core
@@ -0,0 +1,71 @@
+#include "localization/core/pole_store.h"
+
+namespace localization_core {
+
+void PoleStore::Clear() {
+	x_.clear(); y_.clear(); z_.clear();
+	u_x_.clear(); u_y_.clear(); u_z_.clear();
+	end_x_.clear(); end_y_.clear(); end_z_.clear();
+	d_.clear();
+	laser_x_.clear(); laser_y_.clear(); laser_z_.clear();
+	time_.clear();
+	visible_.clear();
+}
+
+int PoleStore::Add(const PoleLine &line, const Eigen::Vector3d &laser_coords, const double &t) {
+	const int i = x_.size();
+	x_.push_back(line.p.x()); y_.push_back(line.p.y()); z_.push_back(line.p.z());
+	u_x_.push_back(line.u.x()); u_y_.push_back(line.u.y()); u_z_.push_back(line.u.z());
+	end_x_.push_back(line.end.x()); end_y_.push_back(line.end.y()); end_z_.push_back(line.end.z());
+	d_.push_back(line.d);
+	laser_x_.push_back(0); laser_y_.push_back(0); laser_z_.push_back(0);
+	time_.push_back(0);
+	if (i % 64 == 0) visible_.push_back(0);
+	Update(i, laser_coords, t);
+	return i;
+}
+
+int PoleStore::size() const {
+	return x_.size();
+}
+
+bool PoleStore::empty() const {
+	return x_.empty();
+}
+
+PoleLine PoleStore::line(const int &i) const {
+	PoleLine line;
+	line.p = Eigen::Vector3d(x_[i], y_[i], z_[i]);
+	line.u = Eigen::Vector3d(u_x_[i], u_y_[i], u_z_[i]);
+	line.end = Eigen::Vector3d(end_x_[i], end_y_[i], end_z_[i]);
+	line.d = d_[i];
+	return line;
+}
+
+Eigen::Vector3d PoleStore::laser_coords(const int &i) const {
+	return Eigen::Vector3d(laser_x_[i], laser_y_[i], laser_z_[i]);
+}
+
+int PoleStore::CountVisible() const {
+	int n = 0;
+	for (int w = 0; w < visible_.size(); w++) n += __builtin_popcountll(visible_[w]);
+	return n;
+}
+
+void PoleStore::Update(const int &i, const Eigen::Vector3d &laser_coords, const double &t) {
+	SetLaserCoords(i, laser_coords);
+	time_[i] = t;
+	visible_[i / 64] |= uint64_t(1) << (i % 64);
+}
+
+void PoleStore::SetLaserCoords(const int &i, const Eigen::Vector3d &laser_coords) {
+	laser_x_[i] = laser_coords.x();
+	laser_y_[i] = laser_coords.y();
+	laser_z_[i] = laser_coords.z();
+}
+
+void PoleStore::Disappear(const int &i) {
+	visible_[i / 64] &= ~(uint64_t(1) << (i % 64));
+}
+
+}	//namespace localization_core
@@ -0,0 +1,236 @@
+#include "localization/core/relocalizer.h"
+#include "localization/core/get_pose.h"
+#include "localization/core/log.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace localization_core {
+
+namespace {
+
+const int kSideBits = 21;	//bits of one quantized side in a triangle key
+const int64_t kMaxSide = (int64_t(1) << kSideBits) - 1;
+//vertex orders of a triangle, odd ones flip its orientation
+const int kPermutations[6][3] = {{0, 1, 2}, {1, 0, 2}, {0, 2, 1}, {2, 1, 0}, {1, 2, 0}, {2, 0, 1}};
+const int kParity[6] = {1, -1, -1, -1, 1, 1};
+
+uint64_t TriangleKey(const int64_t q[3], const int &sign) {
+	return (uint64_t(sign > 0) << 63) | (uint64_t(q[0]) << (2 * kSideBits)) | (uint64_t(q[1]) << kSideBits) | uint64_t(q[2]);
+}
+
+//twice the signed area, positive if the vertices run counter clockwise
+double Area2(const std::vector<double> &x, const std::vector<double> &y, const int vertex[3]) {
+	return (x[vertex[1]] - x[vertex[0]]) * (y[vertex[2]] - y[vertex[0]])
+		- (y[vertex[1]] - y[vertex[0]]) * (x[vertex[2]] - x[vertex[0]]);
+}
+
+//side k lies opposite vertex k
+void Sides(const std::vector<double> &x, const std::vector<double> &y, const int vertex[3], double side[3]) {
+	for (int k = 0; k < 3; k++) {
+		const int a = vertex[(k + 1) % 3], b = vertex[(k + 2) % 3];
+		side[k] = std::sqrt((x[a] - x[b]) * (x[a] - x[b]) + (y[a] - y[b]) * (y[a] - y[b]));
+	}
+}
+
+struct ByKey {
+	template <typename T>
+	bool operator()(const T &a, const T &b) const {
+		if (a.key != b.key) return a.key < b.key;
+		return std::lexicographical_compare(a.vertex, a.vertex + 3, b.vertex, b.vertex + 3);
+	}
+};
+
+struct SameTriangle {
+	template <typename T>
+	bool operator()(const T &a, const T &b) const {
+		return a.key == b.key && std::equal(a.vertex, a.vertex + 3, b.vertex);
+	}
+};
+
+}	//namespace
+
+void Relocalizer::Index(const PoleStore &poles, const RelocalizerParams &params) {
+	params_ = params;
+	map_x_ = poles.x();
+	map_y_ = poles.y();
+	MakeTriangles(map_x_, map_y_, &triangles_);
+	grid_.Build(map_x_, map_y_, params_.match_distance);
+	Log(kLogInfo, "relocalizer indexed %lu triangles of %lu poles", triangles_.size(), map_x_.size());
+}
+
+bool Relocalizer::Relocalize(const std::vector<Eigen::Vector3d> &scans, Pose2D *pose) {
+	matches_ = 0;
+	scan_x_.clear();
+	scan_y_.clear();
+	for (int i = 0; i < scans.size(); i++) {
+		if (!std::isfinite(scans[i].x()) || !std::isfinite(scans[i].y())) continue;
+		scan_x_.push_back(scans[i].x());
+		scan_y_.push_back(scans[i].y());
+	}
+	const int n = scan_x_.size();
+	if (n < 3 || triangles_.empty()) return false;
+	MakeTriangles(scan_x_, scan_y_, &scan_triangles_);
+	best_count_ = 0;
+	best_cost_ = std::numeric_limits<double>::max();
+	for (int t = 0; t < scan_triangles_.size() && best_count_ < n; t++) {
+		const int *vertex = scan_triangles_[t].vertex;
+		double side[3];
+		Sides(scan_x_, scan_y_, vertex, side);
+		const double area2 = Area2(scan_x_, scan_y_, vertex);
+		const int sign = area2 > 0 ? 1 : -1;
+		const bool flat = std::abs(area2) < params_.tolerance * side[2];	//orientation unreliable
+		for (int p = 0; p < 6; p++) {	//orders whose sides are sorted within the noise may match too
+			const int *perm = kPermutations[p];
+			const double permuted_side[3] = {side[perm[0]], side[perm[1]], side[perm[2]]};
+			if (permuted_side[1] < permuted_side[0] - 2 * params_.tolerance ||
+				permuted_side[2] < permuted_side[1] - 2 * params_.tolerance) continue;
+			const int permuted_vertex[3] = {vertex[perm[0]], vertex[perm[1]], vertex[perm[2]]};
+			Lookup(permuted_side, permuted_vertex, sign * kParity[p]);
+			if (flat) Lookup(permuted_side, permuted_vertex, -sign * kParity[p]);
+		}
+	}
+	if (best_count_ < params_.min_matches) {
+		Log(kLogDebug, "relocalizer explained at most %d of %d scan points", best_count_, n);
+		return false;
+	}
+	//refine by the least squares rigid fit of every explained scan point, GetPose only uses ranges and its
+	//average of the bearings is dominated by close poles
+	double sum_scan_x = 0, sum_scan_y = 0, sum_map_x = 0, sum_map_y = 0;
+	for (int i = 0; i < n; i++) {
+		if (best_match_[i] < 0) continue;
+		sum_scan_x += scan_x_[i]; sum_scan_y += scan_y_[i];
+		sum_map_x += map_x_[best_match_[i]]; sum_map_y += map_y_[best_match_[i]];
+	}
+	const double scan_cx = sum_scan_x / best_count_, scan_cy = sum_scan_y / best_count_;
+	const double map_cx = sum_map_x / best_count_, map_cy = sum_map_y / best_count_;
+	double cross = 0, dot = 0;
+	for (int i = 0; i < n; i++) {
+		if (best_match_[i] < 0) continue;
+		const double ax = scan_x_[i] - scan_cx, ay = scan_y_[i] - scan_cy;
+		const double bx = map_x_[best_match_[i]] - map_cx, by = map_y_[best_match_[i]] - map_cy;
+		cross += ax * by - ay * bx;
+		dot += ax * bx + ay * by;
+	}
+	Pose2D refined;
+	refined.theta = atan2(cross, dot);
+	refined.x = map_cx - cos(refined.theta) * scan_cx + sin(refined.theta) * scan_cy;
+	refined.y = map_cy - sin(refined.theta) * scan_cx - cos(refined.theta) * scan_cy;
+	double cost;
+	*pose = CountMatches(refined, &cost) >= best_count_ ? refined : best_pose_;
+	matches_ = best_count_;
+	Log(kLogDebug, "relocalizer explained %d of %d scan points", matches_, n);
+	return true;
+}
+
+//triangles of every point with two of its nearest neighbours, all sides at most max_side, sorted by key
+void Relocalizer::MakeTriangles(const std::vector<double> &x, const std::vector<double> &y,
+	std::vector<Triangle> *triangles) {
+	triangles->clear();
+	const double max_side2 = params_.max_side * params_.max_side;
+	for (int i = 0; i < x.size(); i++) {
+		near_.clear();
+		for (int j = 0; j < x.size(); j++) {
+			const double dist = (x[i] - x[j]) * (x[i] - x[j]) + (y[i] - y[j]) * (y[i] - y[j]);
+			if (j != i && dist <= max_side2) near_.push_back(std::make_pair(dist, j));
+		}
+		const int k = std::min<int>(params_.neighbours, near_.size());
+		std::partial_sort(near_.begin(), near_.begin() + k, near_.end());
+		for (int a = 0; a < k; a++) {
+			for (int b = a + 1; b < k; b++) {
+				const int corner[3] = {i, near_[a].second, near_[b].second};
+				double side[3];
+				Sides(x, y, corner, side);
+				if (side[0] * side[0] > max_side2) continue;
+				int order[3] = {0, 1, 2};	//vertices by length of the opposite side
+				std::sort(order, order + 3, [&](const int &u, const int &v) {return side[u] < side[v];});
+				Triangle triangle;
+				int64_t q[3];
+				for (int m = 0; m < 3; m++) {
+					triangle.vertex[m] = corner[order[m]];
+					q[m] = std::min(GridCell(side[order[m]], params_.tolerance), kMaxSide);
+				}
+				triangle.key = TriangleKey(q, Area2(x, y, triangle.vertex) > 0 ? 1 : -1);
+				triangles->push_back(triangle);
+			}
+		}
+	}
+	std::sort(triangles->begin(), triangles->end(), ByKey());	//found once from every vertex
+	triangles->erase(std::unique(triangles->begin(), triangles->end(), SameTriangle()), triangles->end());
+}
+
+//tests every map triangle whose sides match side within the tolerance
+void Relocalizer::Lookup(const double side[3], const int vertex[3], const int &sign) {
+	int64_t q[3];
+	for (int m = 0; m < 3; m++) q[m] = GridCell(side[m], params_.tolerance);
+	int64_t near_q[3];
+	for (int d = 0; d < 27; d++) {	//neighbouring quantization cells of all three sides
+		near_q[0] = q[0] + d % 3 - 1;
+		near_q[1] = q[1] + d / 3 % 3 - 1;
+		near_q[2] = q[2] + d / 9 - 1;
+		if (*std::min_element(near_q, near_q + 3) < 0 || *std::max_element(near_q, near_q + 3) > kMaxSide) continue;
+		Triangle probe;
+		probe.key = TriangleKey(near_q, sign);
+		probe.vertex[0] = probe.vertex[1] = probe.vertex[2] = -1;
+		std::vector<Triangle>::const_iterator it = std::lower_bound(triangles_.begin(), triangles_.end(), probe,
+			ByKey());
+		for (; it != triangles_.end() && it->key == probe.key; ++it) {
+			double map_side[3];
+			Sides(map_x_, map_y_, it->vertex, map_side);
+			bool match = true;
+			for (int m = 0; m < 3; m++) match = match && std::abs(map_side[m] - side[m]) <= params_.tolerance;
+			if (match) Test(vertex, it->vertex);
+		}
+	}
+}
+
+//solves the pose of three correspondences and keeps it if it explains more scan points than the best so far
+void Relocalizer::Test(const int scan[3], const int pole[3]) {
+	candidate_.Clear();
+	PoleLine line;
+	line.u = Eigen::Vector3d::UnitZ();
+	line.d = 0;
+	for (int k = 0; k < 3; k++) {
+		line.p = line.end = Eigen::Vector3d(map_x_[pole[k]], map_y_[pole[k]], 0);
+		candidate_.Add(line, Eigen::Vector3d(scan_x_[scan[k]], scan_y_[scan[k]], 0), 0);
+	}
+	const Pose2D pose = GetPose(candidate_);
+	if (!std::isfinite(pose.x) || !std::isfinite(pose.y) || !std::isfinite(pose.theta)) return;
+	double cost;
+	const int count = CountMatches(pose, &cost);
+	if (count > best_count_ || (count == best_count_ && cost < best_cost_)) {
+		best_count_ = count;
+		best_cost_ = cost;
+		best_pose_ = pose;
+		best_match_.swap(match_);
+	}
+}
+
+//matches every scan point to the nearest map pole within match_distance under pose
+int Relocalizer::CountMatches(const Pose2D &pose, double *cost) {
+	const int n = scan_x_.size();
+	const double c = cos(pose.theta), s = sin(pose.theta);
+	const double max_dist = params_.match_distance * params_.match_distance;
+	match_.assign(n, -1);
+	*cost = 0;
+	int count = 0;
+	for (int i = 0; i < n; i++) {
+		const double x = pose.x + c * scan_x_[i] - s * scan_y_[i];
+		const double y = pose.y + s * scan_x_[i] + c * scan_y_[i];
+		double best = max_dist;
+		grid_.ForEachNear(x, y, [&](const int &j) {
+			const double dist = (x - map_x_[j]) * (x - map_x_[j]) + (y - map_y_[j]) * (y - map_y_[j]);
+			if (dist <= best) {
+				best = dist;
+				match_[i] = j;
+			}
+		});
+		if (match_[i] >= 0) {
+			count++;
+			*cost += best;
+		}
+	}
+	return count;
+}
+
+}	//namespace localization_core
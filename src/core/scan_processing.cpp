@@ -0,0 +1,92 @@
+#include "localization/core/scan_processing.h"
+#include "localization/core/geometry.h"
+#include <cmath>
+
+namespace localization_core {
+
+void ScanClusterer::Reserve(const int &n_points) {
+	x_.reserve(n_points); y_.reserve(n_points); z_.reserve(n_points);
+	seed_x_.reserve(n_points); seed_y_.reserve(n_points);
+	sum_x_.reserve(n_points); sum_y_.reserve(n_points); sum_z_.reserve(n_points);
+	count_.reserve(n_points);
+}
+
+void ScanClusterer::Clear() {
+	x_.clear(); y_.clear(); z_.clear();
+}
+
+void ScanClusterer::Add(const float &x, const float &y, const float &z) {
+	x_.push_back(x); y_.push_back(y); z_.push_back(z);
+}
+
+int ScanClusterer::size() const {
+	return x_.size();
+}
+
+void ScanClusterer::StartCluster(const int &i) {
+	seed_x_.push_back(x_[i]); seed_y_.push_back(y_[i]);
+	sum_x_.push_back(x_[i]); sum_y_.push_back(y_[i]); sum_z_.push_back(z_[i]);
+	count_.push_back(1);
+}
+
+void ScanClusterer::Join(const int &cluster, const int &i) {
+	sum_x_[cluster] += x_[i]; sum_y_[cluster] += y_[i]; sum_z_[cluster] += z_[i];
+	count_[cluster]++;
+}
+
+bool ScanClusterer::Close(const int &cluster, const int &i) const {	//in circle of 0.5m; disregard z-value
+	const float dx = seed_x_[cluster] - x_[i];
+	const float dy = seed_y_[cluster] - y_[i];
+	return dx * dx + dy * dy < 0.5f * 0.5f;
+}
+
+void ScanClusterer::Cluster(std::vector<Eigen::Vector3d> *scan) {
+	scan->clear();
+	seed_x_.clear(); seed_y_.clear();
+	sum_x_.clear(); sum_y_.clear(); sum_z_.clear();
+	count_.clear();
+	const int n = x_.size();
+	for (int i = 0; i < n; i++) {
+		const int current = count_.size() - 1;
+		if (current >= 0 && Close(current, i)) Join(current, i);
+		else if (current >= 1 && Close(current - 1, i)) Join(current - 1, i);	//stray point between two hits of a pole
+		else StartCluster(i);
+	}
+	int n_clusters = count_.size();
+	if (n_clusters > 1) {	//first and last beams can hit the same pole
+		const float dx = seed_x_[0] - seed_x_[n_clusters - 1];
+		const float dy = seed_y_[0] - seed_y_[n_clusters - 1];
+		if (dx * dx + dy * dy < 0.5f * 0.5f) {
+			sum_x_[0] += sum_x_[n_clusters - 1]; sum_y_[0] += sum_y_[n_clusters - 1]; sum_z_[0] += sum_z_[n_clusters - 1];
+			count_[0] += count_[n_clusters - 1];
+			n_clusters--;
+		}
+	}
+	for (int c = 0; c < n_clusters; c++) {	//average
+		scan->push_back(Eigen::Vector3d(sum_x_[c], sum_y_[c], sum_z_[c]) / count_[c]);
+	}
+}
+
+void MinimizeScans(const std::vector<Eigen::Vector3d> &cloud, std::vector<Eigen::Vector3d> *scan) {
+	ScanClusterer clusterer;
+	clusterer.Reserve(cloud.size());
+	for (int i = 0; i < cloud.size(); i++) clusterer.Add(cloud[i].x(), cloud[i].y(), cloud[i].z());
+	clusterer.Cluster(scan);
+}
+
+void CorrectMoveError(const ScanTiming &timing, const double &delta_theta, const double &delta_t,
+	std::vector<Eigen::Vector3d> *scan_pole_points) {
+	for (int i = 0; i < scan_pole_points->size(); i++) {
+		const Eigen::Vector3d temp_point = scan_pole_points->at(i);
+		double scan_angle = atan2( temp_point.y(), temp_point.x() );
+		const double scan_dist = sqrt( (temp_point.x() * temp_point.x() ) + (temp_point.y() * temp_point.y() ) );
+		const int scan_index = (int)( scan_angle - timing.angle_min ) / timing.angle_increment;
+		const double measurement_delay = ( timing.size - scan_index ) * timing.time_increment;
+		const double time_scale = measurement_delay / delta_t;
+		scan_angle -= delta_theta * time_scale;
+		scan_pole_points->at(i).x() = scan_dist * cos(scan_angle);
+		scan_pole_points->at(i).y() = scan_dist * sin(scan_angle);
+	}
+}
+
+}	//namespace localization_core
@@ -0,0 +1,62 @@
+#include "localization/core/thread_pool.h"
+
+namespace localization_core {
+
+ThreadPool::ThreadPool(const int &n_threads)
+	: task_(0), n_tasks_(0), next_task_(0), busy_threads_(0), generation_(0), stop_(false) {
+	for (int i = 0; i < n_threads; i++) threads_.push_back(std::thread(&ThreadPool::Worker, this));
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	work_cv_.notify_all();
+	for (int i = 0; i < threads_.size(); i++) threads_[i].join();
+}
+
+int ThreadPool::size() const {
+	return threads_.size();
+}
+
+void ThreadPool::RunTasks() {
+	for (int i = next_task_.fetch_add(1); i < n_tasks_; i = next_task_.fetch_add(1)) (*task_)(i);
+}
+
+void ThreadPool::ParallelFor(const int &n, const std::function<void(int)> &task) {
+	if (threads_.empty() || n <= 1) {
+		for (int i = 0; i < n; i++) task(i);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		task_ = &task;
+		n_tasks_ = n;
+		next_task_ = 0;
+		busy_threads_ = threads_.size();
+		generation_++;
+	}
+	work_cv_.notify_all();
+	RunTasks();
+	std::unique_lock<std::mutex> lock(mutex_);
+	done_cv_.wait(lock, [this]() {return busy_threads_ == 0;});
+	task_ = 0;
+}
+
+void ThreadPool::Worker() {
+	long seen_generation = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			work_cv_.wait(lock, [&]() {return stop_ || generation_ != seen_generation;});
+			if (stop_) return;
+			seen_generation = generation_;
+		}
+		RunTasks();
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (--busy_threads_ == 0) done_cv_.notify_one();
+	}
+}
+
+}	//namespace localization_core
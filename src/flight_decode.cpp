@@ -0,0 +1,78 @@
+//Prints a flight recorder dump of the locate node as text, one event per line, oldest first:
+//wall time [s], event name, id and values by name.
+//usage: flight_decode <dump> [event name]
+#include "localization/core/flight_recorder.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using localization_core::FlightDumpHeader;
+using localization_core::FlightEvent;
+using localization_core::FlightEventInfo;
+
+bool BySeq(const FlightEvent &a, const FlightEvent &b) {
+	return a.seq < b.seq;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		std::fprintf(stderr, "usage: %s <dump> [event name]\n", argv[0]);
+		return 1;
+	}
+	FILE *file = std::fopen(argv[1], "rb");
+	if (!file) {
+		std::fprintf(stderr, "could not open %s\n", argv[1]);
+		return 1;
+	}
+	FlightDumpHeader header;
+	if (std::fread(&header, sizeof(header), 1, file) != 1 || header.magic != localization_core::kFlightDumpMagic) {
+		std::fprintf(stderr, "%s is no flight recorder dump or has another byte order\n", argv[1]);
+		return 1;
+	}
+	if (header.version != localization_core::kFlightDumpVersion || header.event_size != sizeof(FlightEvent)) {
+		std::fprintf(stderr, "%s has version %u with %u byte events, expected %u with %lu\n", argv[1], header.version,
+			header.event_size, localization_core::kFlightDumpVersion, sizeof(FlightEvent));
+		return 1;
+	}
+	std::vector<FlightEvent> ring(header.capacity);
+	uint64_t recorded_after = 0;
+	if (std::fread(ring.data(), sizeof(FlightEvent), ring.size(), file) != ring.size()
+		|| std::fread(&recorded_after, sizeof(recorded_after), 1, file) != 1) {
+		std::fprintf(stderr, "%s is truncated\n", argv[1]);
+		return 1;
+	}
+	std::fclose(file);
+	//keep the events that were complete at the time of the dump; the slots of events older than the last
+	//capacity before recorded_after may have been refilled while they were copied, old seq with new values
+	const uint64_t oldest = recorded_after > ring.size() ? recorded_after - ring.size() : 0;
+	std::vector<FlightEvent> events;
+	for (uint64_t i = 0; i < ring.size(); i++) {
+		const FlightEvent &event = ring[i];
+		if (event.seq <= oldest || event.seq > header.recorded || (event.seq - 1) % ring.size() != i) continue;
+		if (!localization_core::GetFlightEventInfo(event.type)) continue;
+		events.push_back(event);
+	}
+	std::sort(events.begin(), events.end(), BySeq);
+	std::fprintf(stderr, "%lu of %lu recorded events\n", events.size(), (unsigned long)header.recorded);
+	const char *filter = argc > 2 ? argv[2] : 0;
+	for (int i = 0; i < events.size(); i++) {
+		const FlightEvent &event = events[i];
+		const FlightEventInfo &info = *localization_core::GetFlightEventInfo(event.type);
+		if (filter && std::strcmp(filter, info.name) != 0) continue;
+		const uint64_t wall_ns = header.wall_ns - (header.steady_ns - event.time_ns);
+		std::printf("%lu.%06lu %s", (unsigned long)(wall_ns / 1000000000), (unsigned long)(wall_ns % 1000000000 / 1000),
+			info.name);
+		if (info.id) std::printf(" %s=%d", info.id, event.id);
+		std::istringstream names(info.values);
+		std::string name;
+		for (int v = 0; v < event.count; v++) {
+			if (!(names >> name)) name = "value";
+			std::printf(" %s=%g", name.c_str(), event.values[v]);
+		}
+		std::printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef LOCALIZATION_LASER_ANGLE_H
+#define LOCALIZATION_LASER_ANGLE_H
+
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+#include "localization/intensity_params.h"
+
+//Extracts the beams hitting a pole from the filtered scan and reports whether a pole is seen
+class LaserAngle {
+ public:
+	explicit LaserAngle(const ros::NodeHandle &n) : n_(n), classifier_(LoadIntensityClassifier(n)) {
+		sub_ = n_.subscribe("/output", 2000, &LaserAngle::Callback, this);
+		pub_ = n_.advertise<sensor_msgs::LaserScan>("/pole_scan",2000);
+	}
+
+ private:
+	ros::NodeHandle n_;
+	ros::Subscriber sub_;
+	ros::Publisher pub_;
+	localization_core::IntensityClassifier classifier_;
+	std::vector<uint64_t> mask_;
+
+	void Callback(const sensor_msgs::LaserScan::ConstPtr &scan) {
+		sensor_msgs::LaserScan::Ptr modified_scan(new sensor_msgs::LaserScan(*scan));
+		bool found_pole = false;
+		double pole_distance = 0;
+		const int n = std::min(scan->ranges.size(), scan->intensities.size());
+		if (n > 0) classifier_.Classify(&scan->ranges[0], &scan->intensities[0], n, &mask_);
+		for (int i = 0; i < scan->ranges.size(); i++) {
+			const bool in_range = scan->ranges[i] >= scan->range_min && scan->ranges[i] <= scan->range_max;
+			if (i < n && in_range && localization_core::IntensityClassifier::Test(mask_, i)) {
+				found_pole = true;
+				pole_distance = scan->ranges[i];
+			}
+			else {
+				modified_scan->ranges[i] = 0;
+				if (i < modified_scan->intensities.size()) modified_scan->intensities[i] = 0;
+			}
+		}
+		if (found_pole) ROS_INFO("Found pole at %fm", pole_distance);
+		else ROS_WARN("No pole!");
+		pub_.publish(modified_scan);
+	}
+};
+
+#endif
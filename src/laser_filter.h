@@ -0,0 +1,85 @@
+#ifndef LOCALIZATION_LASER_FILTER_H
+#define LOCALIZATION_LASER_FILTER_H
+
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+#include "message_filters/subscriber.h"
+#include "tf/message_filter.h"
+#include "tf/transform_listener.h"
+#include "filters/filter_chain.h"
+#include <pluginlib/class_loader.h>
+#include "localization/intensity_params.h"
+
+class GenericLaserScanFilterNode
+{
+protected:
+  // Our NodeHandle
+  ros::NodeHandle nh_;
+
+  // Components for tf::MessageFilter
+  tf::TransformListener tf_;
+  message_filters::Subscriber<sensor_msgs::LaserScan> scan_sub_;
+  tf::MessageFilter<sensor_msgs::LaserScan> tf_filter_;
+
+  // Filter Chain
+  filters::FilterChain<sensor_msgs::LaserScan> filter_chain_;
+  bool chain_configured_;
+
+  // Reflective beam classification shared with locate and laser_angle
+  bool classify_poles_;
+  localization_core::IntensityClassifier classifier_;
+  std::vector<uint64_t> mask_;
+
+  // Components for publishing
+  ros::Publisher output_pub_;
+
+public:
+  // Constructor, parameters are read from private_nh
+  GenericLaserScanFilterNode(const ros::NodeHandle &nh, const ros::NodeHandle &private_nh) :
+      nh_(nh),
+      scan_sub_(nh_, "/scan", 50),
+      tf_filter_(scan_sub_, tf_, "laser_frame", 50),
+      filter_chain_("sensor_msgs::LaserScan"),
+      classifier_(LoadIntensityClassifier(private_nh))
+  {
+    // Configure filter chain, it may be empty when the classifier does the intensity filtering
+    chain_configured_ = filter_chain_.configure("test", private_nh);
+    private_nh.param("classify_poles", classify_poles_, false);
+
+    // Setup tf::MessageFilter for input
+    tf_filter_.registerCallback(
+        boost::bind(&GenericLaserScanFilterNode::callback, this, _1));
+    tf_filter_.setTolerance(ros::Duration(0.03));
+
+    // Advertise output
+    output_pub_ = nh_.advertise<sensor_msgs::LaserScan>("output", 1000);
+  }
+
+  // Callback
+  void callback(const sensor_msgs::LaserScan::ConstPtr& msg_in)
+  {
+    // A new message for every scan, subscribers in the same process share it without a copy
+    sensor_msgs::LaserScan::Ptr msg(new sensor_msgs::LaserScan);
+
+    // Run the filter chain
+    if (chain_configured_) filter_chain_.update (*msg_in, *msg);
+    else *msg = *msg_in;
+
+    // Drop every beam that did not hit a pole, out of range beams are skipped by the projection.
+    // Their intensities go too, a subscriber that classifies again must not find a pole beyond range_max
+    if (classify_poles_ && !msg->intensities.empty()) {
+      const int n = std::min(msg->ranges.size(), msg->intensities.size());
+      classifier_.Classify(&msg->ranges[0], &msg->intensities[0], n, &mask_);
+      for (int i = 0; i < n; i++) {
+        if (localization_core::IntensityClassifier::Test(mask_, i)) continue;
+        msg->ranges[i] = msg->range_max + 1;
+        msg->intensities[i] = 0;
+      }
+    }
+
+    // Publish the output, msg must not change after this
+    output_pub_.publish(msg);
+  }
+};
+
+#endif
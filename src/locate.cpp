@@ -1,8 +1,25 @@
-#include "locate_helper.cpp"
-#include "localization/scan_point.h"
+#include "locate.h"
+#include "localization/core/log.h"
+#include <chrono>
 
-Loc::Loc() {
+namespace {
+
+void RosLogHandler(const localization_core::LogLevel &level, const char *message) {	//core log output to rosconsole
+	switch (level) {
+		case localization_core::kLogDebug: ROS_DEBUG("%s", message); break;
+		case localization_core::kLogInfo: ROS_INFO("%s", message); break;
+		case localization_core::kLogWarn: ROS_WARN("%s", message); break;
+		default: ROS_ERROR("%s", message); break;
+	}
+}
+
+}	//namespace
+
+Loc::Loc(const ros::NodeHandle &n) : n_(n), running_(true), sensor_n_(n), scan_n_(n),
+	empty_scan_(new sensor_msgs::LaserScan), classifier_(LoadIntensityClassifier(n)), pipeline_running_(false),
+	estimation_queue_(4), publish_queue_(4) {
 	ROS_INFO("Started localization node");
+	localization_core::SetLogHandler(RosLogHandler);
 	//read config from file
 	if (ros::param::get("b", b));	//wheel distance of robot
 	else {
@@ -19,21 +36,37 @@ Loc::Loc() {
 		use_odometry_ = false;
 		ROS_WARN("Didn't find config for use_odometry_");
 	}
-	if (ros::param::get("scan_covariance", scan_covariance_));	//wheel distance of robot
+	if (ros::param::get("scan_covariance", filter_params_.scan_covariance));	//wheel distance of robot
 	else {
-		scan_covariance_ = 0.02*0.02;
+		filter_params_.scan_covariance = 0.02*0.02;
 		ROS_WARN("Didn't find config for scan_covariance_");
 	}
-	if (ros::param::get("k_s", k_s_));	//wheel distance of robot
+	if (ros::param::get("k_s", filter_params_.k_s));	//wheel distance of robot
 	else {
-		k_s_ = 100;
+		filter_params_.k_s = 100;
 		ROS_WARN("Didn't find config for k_s_");
 	}
-	if (ros::param::get("k_th", k_th_));	//wheel distance of robot
+	if (ros::param::get("k_th", filter_params_.k_th));	//wheel distance of robot
 	else {
-		k_th_ = 100;
+		filter_params_.k_th = 100;
 		ROS_WARN("Didn't find config for k_th_");
 	}
+	if (ros::param::get("single_precision_filter", filter_params_.single_precision));	//float kernels
+	else {
+		filter_params_.single_precision = false;
+		ROS_WARN("Didn't find config for single_precision_filter");
+	}
+	if (ros::param::get("pose_fit_iterations", pose_fit_params_.max_iterations));	//bound of the initial pose fit
+	else {
+		pose_fit_params_.max_iterations = 20;
+		ROS_WARN("Didn't find config for pose_fit_iterations");
+	}
+	if (ros::param::get("pose_fit_huber", pose_fit_params_.huber_delta));	//residual beyond which a pole is an outlier
+	else {
+		pose_fit_params_.huber_delta = 0.1;
+		ROS_WARN("Didn't find config for pose_fit_huber");
+	}
+	pose_fit_params_.scan_covariance = filter_params_.scan_covariance;
 	if (ros::param::get("laser_offset", laser_offset_));	//wheel distance of robot
 	else {
 		laser_offset_ = 0.05;
@@ -44,16 +77,87 @@ Loc::Loc() {
 		laser_height_ = 0.35;
 		ROS_WARN("Didn't find config for laser_height");
 	}
-	sub_scan_ = n_.subscribe("/output",1, &Loc::ScanCallback, this);
-	sub_odom_ = n_.subscribe("/io_from_board",1, &Loc::OdomCallback, this);
-	sub_imu_ = n_.subscribe("/imu/data",5, &Loc::ImuCallback, this);
+	if (ros::param::get("event_driven", event_driven_));	//run filter on scan arrival
+	else {
+		event_driven_ = false;
+		ROS_WARN("Didn't find config for event_driven");
+	}
+	if (ros::param::get("pipelined", pipelined_));	//run stages on separate threads
+	else {
+		pipelined_ = false;
+		ROS_WARN("Didn't find config for pipelined");
+	}
+	if (ros::param::get("relocalize_after", relocalize_after_));	//lost scans before searching the map
+	else {
+		relocalize_after_ = 5;
+		ROS_WARN("Didn't find config for relocalize_after");
+	}
+	if (ros::param::get("relocalize_max_side", relocalizer_params_.max_side));
+	else {
+		relocalizer_params_.max_side = 10.0;
+		ROS_WARN("Didn't find config for relocalize_max_side");
+	}
+	if (ros::param::get("relocalize_tolerance", relocalizer_params_.tolerance));
+	else {
+		relocalizer_params_.tolerance = 0.05;
+		ROS_WARN("Didn't find config for relocalize_tolerance");
+	}
+	if (ros::param::get("relocalize_match_distance", relocalizer_params_.match_distance));
+	else {
+		relocalizer_params_.match_distance = 0.2;
+		ROS_WARN("Didn't find config for relocalize_match_distance");
+	}
+	if (ros::param::get("relocalize_neighbours", relocalizer_params_.neighbours));
+	else {
+		relocalizer_params_.neighbours = 8;
+		ROS_WARN("Didn't find config for relocalize_neighbours");
+	}
+	if (ros::param::get("relocalize_min_matches", relocalizer_params_.min_matches));
+	else {
+		relocalizer_params_.min_matches = 3;
+		ROS_WARN("Didn't find config for relocalize_min_matches");
+	}
+	lost_scans_ = 0;
+	if (ros::param::get("map_file", map_file_));	//skip initiation if the stored map matches the scans
+	else {
+		map_file_.clear();
+		ROS_WARN("Didn't find config for map_file");
+	}
+	if (ros::param::get("flight_recorder_file", flight_recorder_file_)) {	//dump the recorded events when crashing
+		localization_core::DumpFlightRecorderOnCrash(flight_recorder_file_);
+	}
+	else {
+		flight_recorder_file_.clear();
+		ROS_WARN("Didn't find config for flight_recorder_file");
+	}
+	if (ros::param::get("streaming_initiation", streaming_initiation_));	//accumulate poles scan by scan
+	else {
+		streaming_initiation_ = false;
+		ROS_WARN("Didn't find config for streaming_initiation");
+	}
+	n_.setCallbackQueue(&main_queue_);
+	sensor_n_.setCallbackQueue(&sensor_queue_);
+	scan_n_.setCallbackQueue(&scan_queue_);
+	//when pipelined, sensor and scan callbacks are served by their own spinners
+	sub_scan_ = (pipelined_ ? scan_n_ : n_).subscribe("/output",1, &Loc::ScanCallback, this);
+	sub_odom_ = (pipelined_ ? sensor_n_ : n_).subscribe("/io_from_board",1, &Loc::OdomCallback, this);
+	sub_imu_ = (pipelined_ ? sensor_n_ : n_).subscribe("/imu/data",5, &Loc::ImuCallback, this);
 	srv_init_ = n_.advertiseService("initialize_localization", &Loc::InitService, this);
+	srv_dump_ = n_.advertiseService("dump_flight_recorder", &Loc::DumpService, this);
 	ROS_INFO("Subscribed to \"scan\" topic");
 	pub_pose_ = n_.advertise<geometry_msgs::PoseStamped>("bot_pose",1000);
 	pub_pole_ = n_.advertise<geometry_msgs::PointStamped>("pole_pos",1000);
 	pub_map_ = n_.advertise<localization::beach_map>("beach_map",1000,true);
 	pub_marker_ = n_.advertise<visualization_msgs::Marker>("/lines", 10, true);
 	pub_cloud_ = n_.advertise<sensor_msgs::PointCloud>("/cloud", 1, true);
+#ifdef LOCALIZATION_TRACING
+	pub_trace_ = n_.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+	trace_timer_ = n_.createWallTimer(ros::WallDuration(1.0), &Loc::PublishTrace, this);
+	if (ros::param::get("trace_file", trace_file_)) {	//record events for the chrome trace
+		stage_trace::EnableEvents();
+		ROS_INFO("Writing stage trace to %s on shutdown", trace_file_.c_str());
+	}
+#endif
 	SetInit(true);	//start with initiation
 	pose_.pose.pose.position.x = -2000;	//for recognition if first time calculating
 	last_pose_.pose.pose.position.x = -2000;	
@@ -61,18 +165,40 @@ Loc::Loc() {
 	last_odom_.timestamp = 0;
 	attitude_.orientation.x = -2000;
 	last_attitude_.orientation.x = -2000;
-	ros::spinOnce();	//get initial data
-	ScanToCloud();
+	scan_ = empty_scan_;
+}
+
+void Loc::Run() {
+	SpinOnce();	//get initial data
+	ScanToCloud(*scan_, &cloud_);
+	if (!map_file_.empty()) StartFromStoredMap();
 	StateHandler();
 }
 
+void Loc::Shutdown() {
+	running_ = false;
+}
+
+bool Loc::Ok() const {
+	return running_ && ros::ok();
+}
+
+Loc::~Loc() {
+	StopPipeline();
+#ifdef LOCALIZATION_TRACING
+	if (!trace_file_.empty() && !stage_trace::DumpChromeTrace(trace_file_)) {
+		ROS_ERROR("Could not write stage trace to %s", trace_file_.c_str());
+	}
+#endif
+}
+
 void Loc::StateHandler() {	//runs either initiation or localization
-	while (ros::ok()) {
+	while (Ok()) {
 		if (initiation_) {
 			if(sub_scan_.getNumPublishers() == 0) {	//wait for laser to publish data
 				ros::Rate scan_rate(1);
 				ROS_WARN("No publisher on topic \"/scan\". Trying again every second...");
-				while(sub_scan_.getNumPublishers() == 0 && ros::ok()) {
+				while(sub_scan_.getNumPublishers() == 0 && Ok()) {
 					scan_rate.sleep();
 				}
 			}
@@ -85,218 +211,338 @@ void Loc::StateHandler() {	//runs either initiation or localization
 }
 
 void Loc::Locate() {
+	if (pipelined_) {	//stages run on their own threads; only serve services here
+		if (!pipeline_running_) StartPipeline();
+		main_queue_.callAvailable(ros::WallDuration(0.1));
+		return;
+	}
+	if (event_driven_) {	//ScanCallback does the work; just wait for the next callback
+		main_queue_.callAvailable(ros::WallDuration(0.1));
+		return;
+	}
 	ros::Rate loop_rate(25);
 	//RefreshData();
-	ros::spinOnce();
-	ScanToCloud();
+	SpinOnce();
+	ProcessScan();
+	loop_rate.sleep();
+}
+
+#ifdef LOCALIZATION_TRACING
+//publishes p50/p99/max latency of every stage since start
+void Loc::PublishTrace(const ros::WallTimerEvent &event) {
+	std::vector<stage_trace::Summary> summaries;
+	stage_trace::Summarize(&summaries);
+	diagnostic_msgs::DiagnosticArray array;
+	array.header.stamp = ros::Time::now();
+	for (int i = 0; i < summaries.size(); i++) {
+		diagnostic_msgs::DiagnosticStatus status;
+		status.level = diagnostic_msgs::DiagnosticStatus::OK;
+		status.name = std::string("locate/") + stage_trace::StageName(i);
+		status.message = "latency [ms]";
+		const double values[] = {summaries[i].p50_ns * 1e-6, summaries[i].p99_ns * 1e-6, summaries[i].max_ns * 1e-6};
+		const char* keys[] = {"p50", "p99", "max"};
+		for (int j = 0; j < 3; j++) {
+			diagnostic_msgs::KeyValue value;
+			value.key = keys[j];
+			std::stringstream ss;
+			ss << values[j];
+			value.value = ss.str();
+			status.values.push_back(value);
+		}
+		diagnostic_msgs::KeyValue count;
+		count.key = "count";
+		std::stringstream ss;
+		ss << summaries[i].count;
+		count.value = ss.str();
+		status.values.push_back(count);
+		array.status.push_back(status);
+	}
+	pub_trace_.publish(array);
+}
+#endif
+
+//runs the whole chain from projection to publishing for the scan in scan_
+void Loc::ProcessScan() {
+	ScanToCloud(*scan_, &cloud_);
+	MinimizeScans(cloud_, &pole_scans_);
 	PublishCloud(cloud_);
-	if (!scan_.ranges.empty()) DoTheKalman();
-	PublishPose();
+	if (!scan_->ranges.empty()) DoTheKalman();
+	PublishPose(pose_);
 	EstimateInvisiblePoles();
 	//PrintPose();
-	PublishPoles();
-	PublishTf();
-	loop_rate.sleep();
+	PublishPoles(poles_, current_time_);
+	PublishTf(pose_, current_time_);
+}
+
+//serves the callbacks the state loop waits for, including the pipeline queues while they have no spinners
+void Loc::SpinOnce() {
+	main_queue_.callAvailable();
+	if (pipelined_ && !pipeline_running_) {
+		sensor_queue_.callAvailable();
+		scan_queue_.callAvailable();
+	}
+}
+
+//Pipelined mode: the sensor spinner handles imu and odometry, the scan spinner projects and clusters
+//every scan, the estimation thread runs the filter and the publish thread sends the results.
+//Stages are linked by bounded SPSC queues and every frame passes each stage in arrival order,
+//so the published poses are the same as when processing the scans one after another.
+void Loc::StartPipeline() {
+	sensor_attitude_ = attitude_;	//continue from the state left by initiation
+	sensor_odom_ = odom_;
+	sensor_last_odom_ = last_odom_;
+	pipeline_running_ = true;
+	estimation_thread_ = std::thread(&Loc::EstimationLoop, this);
+	publish_thread_ = std::thread(&Loc::PublishLoop, this);
+	sensor_spinner_.reset(new ros::AsyncSpinner(1, &sensor_queue_));
+	scan_spinner_.reset(new ros::AsyncSpinner(1, &scan_queue_));
+	sensor_spinner_->start();
+	scan_spinner_->start();
+	ROS_INFO("Started pipelined localization");
+}
+
+void Loc::StopPipeline() {
+	if (!pipeline_running_) return;
+	pipeline_running_ = false;
+	sensor_spinner_->stop();
+	scan_spinner_->stop();
+	estimation_thread_.join();
+	publish_thread_.join();
+	ScanFrame scan_frame;	//drop frames still in flight
+	while (estimation_queue_.Pop(&scan_frame));
+	PublishFrame publish_frame;
+	while (publish_queue_.Pop(&publish_frame));
+	attitude_ = sensor_attitude_;	//hand latest sensor data back to the single threaded path
+	odom_ = sensor_odom_;
+	last_odom_ = sensor_last_odom_;
+}
+
+void Loc::EstimationLoop() {
+	ScanFrame frame;
+	PublishFrame out;
+	while (pipeline_running_ && Ok()) {
+		if (!estimation_queue_.Pop(&frame)) {
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+			continue;
+		}
+		//swap so the buffers of the previous frame go back to the scan stage with the next pop
+		scan_.swap(frame.scan);
+		cloud_.points.swap(frame.cloud.points);
+		cloud_.channels.swap(frame.cloud.channels);
+		cloud_.header = frame.cloud.header;
+		pole_scans_.swap(frame.pole_scans);
+		attitude_ = frame.attitude;
+		odom_ = frame.odom;
+		last_odom_ = frame.last_odom;
+		SetTime();
+		DoTheKalman();
+		EstimateInvisiblePoles();
+		out.cloud.points.swap(cloud_.points);	//cloud_ is projected anew for the next frame
+		out.cloud.channels.swap(cloud_.channels);
+		out.cloud.header = cloud_.header;
+		out.pose = pose_;
+		out.poles = poles_;	//copies into the capacity of an earlier frame
+		out.time = current_time_;
+		while (!publish_queue_.Push(out) && pipeline_running_) {
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+	}
+}
+
+void Loc::PublishLoop() {
+	PublishFrame frame;
+	while (pipeline_running_ && Ok()) {
+		if (!publish_queue_.Pop(&frame)) {
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+			continue;
+		}
+		PublishCloud(frame.cloud);
+		PublishPose(frame.pose);
+		PublishPoles(frame.poles, frame.time);
+		PublishTf(frame.pose, frame.time);
+	}
 }
 
 //takes a vector of pole scan data and assigns them to the respective poles
 void Loc::UpdatePoles(const std::vector<Eigen::Vector3d> &scans_to_sort) {
-	ROS_INFO("pred_movement [%f %f] %frad", pred_pose_.position.x - pose_.pose.pose.position.x, 
+	LOC_TRACE_SCOPE(kUpdatePoles);
+	ROS_DEBUG("pred_movement [%f %f] %frad", pred_pose_.position.x - pose_.pose.pose.position.x, 
 		pred_pose_.position.y - pose_.pose.pose.position.y,
 		tf::getYaw(pred_pose_.orientation) - tf::getYaw(pose_.pose.pose.orientation));
 	if (last_pose_.pose.pose.position.x != -2000 && pose_.pose.pose.position.x != -2000) {
-		for(int i = 0; i < scans_to_sort.size(); i++) {	//find closest pole for every scan
-			double min_dist = 2000000;
-			double polar_dist;
-			Eigen::Vector3d correct_scan;
-			int index = -1;
-			//ROS_INFO("sort_scan_dist %f sort_scan_angle %f", scans_to_sort[i].distance, scans_to_sort[i].angle);
-			for (int j = 0; j < poles_.size(); j++) {
-				const Eigen::Vector3d current_pole = poles_[j].line().p;
-				const double dx = current_pole.x() - pred_pose_.position.x;
-				const double dy = current_pole.y() - pred_pose_.position.y;
-				const double dz = current_pole.z() - pred_pose_.position.z;
-				Eigen::Vector3d current_scan(dx, dy, dz);
-				const double theta = tf::getYaw(pred_pose_.orientation);
-				Eigen::Matrix3d rot;
-				rot = Eigen::AngleAxis<double>(-theta, Eigen::Vector3d::UnitZ());
-				current_scan = rot * current_scan;
-				const double current_dist = (scans_to_sort[i].x() - current_scan.x()) * (scans_to_sort[i].x() - current_scan.x())
-					+ (scans_to_sort[i].y() - current_scan.y()) * (scans_to_sort[i].y() - current_scan.y());
-				//ROS_INFO("i %d j %d current_dist %f scan_dist %f scan_angle %f", i, j, current_dist, current_scan.distance, current_scan.angle);
-				if (current_dist < min_dist) {
-					min_dist = current_dist;
-					correct_scan = current_scan;
-					index = j;
-				}
-			}
-			assert(index != -1);
-			double min_angle = atan2(scans_to_sort[i].y(), scans_to_sort[i].x() ) - atan2(correct_scan.y(), correct_scan.x() );
-			ROS_INFO("current_scan [%f %f %f]", scans_to_sort[i].x(), scans_to_sort[i].y(), scans_to_sort[i].z());
-			ROS_INFO("correct_scan [%f %f %f]", correct_scan.x(), correct_scan.y(), correct_scan.z());
-			NormalizeAngle(min_angle);
-			min_angle = std::abs(min_angle);
-			ROS_INFO("min dist %f min angle %f", min_dist, min_angle);
-			if (poles_[index].visible()) {
-				if (min_dist < 0.2*0.2 && min_angle < 0.1) {
-					poles_[index].update(scans_to_sort[i], cloud_.header.stamp);
-				}
-			}
-			else {//more tolerance if pole wasn't visible
-				if (min_dist < 0.4*0.4 && min_angle < 0.2) {
-					poles_[index].update(scans_to_sort[i], cloud_.header.stamp);		//how close the new measurement has to be to the old one !d²!
-				}
-			}
-		}
-		for (int i = 0; i < poles_.size(); i++) {	//hide all missing poles
-			if (poles_[i].time() != cloud_.header.stamp) poles_[i].disappear();
-		}
-		//PrintPoleScanData();
+		associator_.Associate(scans_to_sort, ToPose2D(pred_pose_), cloud_.header.stamp.toSec(), &poles_);
 	}
 }
 
 void Loc::EstimateInvisiblePoles() {
-	//ROS_INFO("Estimating poles");
-	for (int i = 0; i < poles_.size(); i++) {
-		if (!poles_[i].visible()) {
-			Eigen::Matrix3d rot;
-			rot = Eigen::AngleAxis<double>(-tf::getYaw(pose_.pose.pose.orientation), Eigen::Vector3d::UnitZ());
-			poles_[i].update(rot * poles_[i].line().p);
-			//ROS_INFO("Changed pole %d to %f m %f rad", i, temp_scan.distance, temp_scan.angle);
-		}
+	LOC_TRACE_SCOPE(kEstimateInvisiblePoles);
+	localization_core::EstimateInvisiblePoles(tf::getYaw(pose_.pose.pose.orientation), &poles_);
+}
+
+//searches the map for the pose of the current pole scans when tracking is lost, instead of a new initiation
+void Loc::Relocalize(Eigen::Vector3d *state, Eigen::Matrix3d *covariance) {
+	LOC_TRACE_SCOPE(kRelocalize);
+	localization_core::Pose2D pose;
+	if (!relocalizer_.Relocalize(pole_scans_, &pose)) {
+		ROS_WARN("Tracking lost for %d scans, no pose explains the %lu pole points", lost_scans_, pole_scans_.size());
+		return;
 	}
-	//ROS_INFO("Done estimating");
+	ROS_WARN("Tracking lost, relocalized to [%f %f] %f rad from %d of %lu pole points", pose.x, pose.y, pose.theta,
+		relocalizer_.matches(), pole_scans_.size());
+	*state << pose.x, pose.y, pose.theta;
+	*covariance = Eigen::Matrix3d::Identity() * 0.1;	//as after initiation
+	pred_pose_.position.x = pose.x;
+	pred_pose_.position.y = pose.y;
+	pred_pose_.orientation = tf::createQuaternionMsgFromYaw(pose.theta);
+	//a pole matched at the lost pose has the current stamp too, the association would keep it visible
+	for (int i = 0; i < poles_.size(); i++) poles_.Disappear(i);
+	UpdatePoles(pole_scans_);	//associate again at the found pose
+	lost_scans_ = 0;
 }
 
 bool Loc::IsPolePoint(const double &intensity, const double &distance) {
-	double comparison_intensity = -1;
-	if (distance < 0.5) return false;
-	if (distance >= 0.5 && distance < 1) comparison_intensity = (1750-950)/(1-0.326)*(distance-0.326)+950;
-	if (distance >= 1 && distance < 3.627) comparison_intensity = (1375-1750)/(3.627-1)*(distance-1)+1750;
-	if (distance >= 3.627 && distance <= 8) comparison_intensity = (1175-1375)/(5.597-3.627)*(distance-3.627)+1375;
-	if (distance > 8) comparison_intensity = 931;	//mostly in because of fake_scan
-	if (intensity > comparison_intensity && intensity < 3000) return true; //intensity <3000 to filter blinding sunlight
-	else return false;
+	return classifier_.IsReflective(distance, intensity);
 }
 
 //Groups cloud points belonging to one pole together and averages them
-void Loc::MinimizeScans(std::vector<Eigen::Vector3d> *scan) {
-	scan->clear();
-	std::vector<geometry_msgs::Point32> target; 
-	std::vector<int> already_processed;
-	//don't run if no poles visible
-	if (!cloud_.points.empty()) {
-		for (int i = 0; i < cloud_.points.size(); i++) {	//loop over all poles
-			//don't run if pole is already done
-			if(std::find(already_processed.begin(), already_processed.end(), i) != already_processed.end());
-			else {	//loop over remaining poles
-				target.push_back(cloud_.points.at(i));	//check if point is last in vector
-				int ppp = 1;
-				if(i+1 != cloud_.points.size()) for (int j = i+1; j < cloud_.points.size(); j++) {
-					//check already_processed
-					if(std::find(already_processed.begin(), already_processed.end(), j) != already_processed.end());
-					else {	//check if close enough
-						const double dx = cloud_.points.at(i).x - cloud_.points.at(j).x;
-						const double dy = cloud_.points.at(i).y - cloud_.points.at(j).y;
-						if ( (dx * dx + dy * dy) < 0.5 * 0.5) {	//group if in circle of 0.5m; disregard z-value
-							ppp++;
-							already_processed.push_back(j);
-							target.back().x += cloud_.points.at(j).x;
-							target.back().y += cloud_.points.at(j).y;
-							target.back().z += cloud_.points.at(j).z;
-						}
-					}
-				}
-				already_processed.push_back(i);
-				target.back().x /= ppp; //average
-				target.back().y /= ppp;
-				target.back().z /= ppp;
-				//ROS_INFO("Found %d point/s for pole %d", ppp, i);
-				//ROS_INFO("Pole %d minimized [%f %f %f]", i, target.back().x, target.back().y, target.back().z);
-			}
-		}
-	}
-	for (int i = 0; i < target.size(); i++) {	//convert Point32 to Vector3d
-		scan->push_back( Eigen::Vector3d( target[i].x, target[i].y, target[i].z ) );
+void Loc::MinimizeScans(const sensor_msgs::PointCloud &cloud, std::vector<Eigen::Vector3d> *scan) {
+	LOC_TRACE_SCOPE(kMinimizeScans);
+	clusterer_.Clear();
+	for (int i = 0; i < cloud.points.size(); i++) {	//points are in beam order
+		clusterer_.Add(cloud.points[i].x, cloud.points[i].y, cloud.points[i].z);
 	}
+	clusterer_.Cluster(scan);
 }
 
 void Loc::CorrectMoveError(std::vector<Eigen::Vector3d> *scan_pole_points) {	//correct error due to moving laser
+	LOC_TRACE_SCOPE(kCorrectMoveError);
 	if (last_pose_.pose.pose.position.x != -2000 && pose_.pose.pose.position.x != -2000) {	
-		for (int i = 0; i < scan_pole_points->size(); i++) {
-			Eigen::Vector3d temp_point = scan_pole_points->at(i);
-			double scan_angle = atan2( temp_point.y(), temp_point.x() );
-			const double scan_dist = sqrt( (temp_point.x() * temp_point.x() ) + (temp_point.y() * temp_point.y() ) );
-			const int scan_index = (int)( scan_angle - scan_.angle_min ) / scan_.angle_increment;
-			const double measurement_delay = ( scan_.ranges.size() - scan_index ) * scan_.time_increment;
-			const double delta_t_old = ( attitude_.header.stamp - last_attitude_.header.stamp ).toSec();
-			const double time_scale = measurement_delay / delta_t_old;
-			const double last_theta = tf::getYaw( last_attitude_.orientation );
-			const double current_theta = tf::getYaw( attitude_.orientation );
-			double delta_theta = ( current_theta - last_theta );
-			NormalizeAngle(delta_theta);
-			delta_theta *= time_scale;
-			//ROS_INFO("Corrected angle %d by %f with scale %f", i, delta_theta, time_scale);
-			scan_angle -= delta_theta;
-			scan_pole_points->at(i).x() = scan_dist * cos(scan_angle);
-			scan_pole_points->at(i).y() = scan_dist * sin(scan_angle);
-		}
+		localization_core::ScanTiming timing;
+		timing.angle_min = scan_->angle_min;
+		timing.angle_increment = scan_->angle_increment;
+		timing.time_increment = scan_->time_increment;
+		timing.size = scan_->ranges.size();
+		const double delta_t_old = ( attitude_.header.stamp - last_attitude_.header.stamp ).toSec();
+		double delta_theta = tf::getYaw( attitude_.orientation ) - tf::getYaw( last_attitude_.orientation );
+		localization_core::NormalizeAngle(delta_theta);
+		localization_core::CorrectMoveError(timing, delta_theta, delta_t_old, scan_pole_points);
 	}
 }
 
-void Loc::ScanToCloud() {
-	laser_geometry::LaserProjection projector;
-	if(!listener_.waitForTransform(scan_.header.frame_id,"/robot_frame",
-		scan_.header.stamp + ros::Duration().fromSec(scan_.ranges.size()*scan_.time_increment),
-		ros::Duration(0.1))) {
+//projects scan into robot frame; cloud keeps its old content if that fails
+bool Loc::ScanToCloud(const sensor_msgs::LaserScan &scan, sensor_msgs::PointCloud *cloud) {
+	LOC_TRACE_SCOPE(kScanToCloud);
+	const ros::Time end_time = scan.header.stamp + ros::Duration().fromSec(scan.ranges.size()*scan.time_increment);
+	if(!listener_.waitForTransform(scan.header.frame_id,"/robot_frame", end_time, ros::Duration(0.1))) {
 			ROS_WARN("Got no transform");
-			return;
+			return false;
   }
-	sensor_msgs::PointCloud temp_cloud;
-	try {
-		projector.transformLaserScanToPointCloud("/robot_frame",scan_,cloud_,listener_);
-		cloud_.header.stamp = scan_.header.stamp + ros::Duration().fromSec(scan_.ranges.size() * scan_.time_increment);
+	tf::StampedTransform start_transform, end_transform;
+	try {	//laser pose at start and end of the scan, interpolated per beam
+		listener_.lookupTransform("/robot_frame", scan.header.frame_id, scan.header.stamp, start_transform);
+		listener_.lookupTransform("/robot_frame", scan.header.frame_id, end_time, end_transform);
+	}
+	catch(tf::TransformException &ex) {
+		ROS_WARN("Error when extrapolating: %s", ex.what());
+		return false;
 	}
-	catch(tf2::ExtrapolationException) {
-		ROS_WARN("Error when extrapolating");
+	cloud->header = scan.header;
+	cloud->header.frame_id = "/robot_frame";
+	cloud->header.stamp = end_time;
+	cloud->points.clear();
+	cloud->channels.resize(2);
+	cloud->channels[0].name = "intensities";
+	cloud->channels[0].values.clear();
+	cloud->channels[1].name = "index";
+	cloud->channels[1].values.clear();
+	const int n = std::min(scan.ranges.size(), scan.intensities.size());
+	if (n == 0) return true;
+	//only beams that hit a pole are projected
+	classifier_.Classify(&scan.ranges[0], &scan.intensities[0], n, &beam_mask_);
+	projector_.SetGeometry(scan.angle_min, scan.angle_increment, n);
+	projector_.Project(&scan.ranges[0], beam_mask_, scan.range_min, scan.range_max, ToRigidTransform(start_transform),
+		ToRigidTransform(end_transform), &beam_points_, &beam_indices_);
+	cloud->points.resize(beam_points_.size());
+	cloud->channels[0].values.resize(beam_points_.size());
+	cloud->channels[1].values.resize(beam_points_.size());
+	for (int i = 0; i < beam_points_.size(); i++) {
+		cloud->points[i].x = beam_points_[i].x();
+		cloud->points[i].y = beam_points_[i].y();
+		cloud->points[i].z = beam_points_[i].z();
+		cloud->channels[0].values[i] = scan.intensities[beam_indices_[i]];
+		cloud->channels[1].values[i] = beam_indices_[i];
 	}
+	return true;
 }
 
-void Loc::ScanCallback(const sensor_msgs::LaserScan &scan) {
-	if (scan.intensities.size() > 0) {	//don't take scans from old laser
-		scan_ = scan;
-		
+void Loc::ScanCallback(const sensor_msgs::LaserScan::ConstPtr &scan) {
+	if (pipeline_running_) {	//projection and clustering stage of the pipeline
+		if (scan->intensities.empty()) {
+			ROS_ERROR("Receiving empty laser messages");
+			return;
+		}
+		ScanFrame &frame = scan_frame_;	//holds the buffers of an earlier frame, refilled in place
+		if (!ScanToCloud(*scan, &frame.cloud)) return;	//no transform, nothing to measure
+		frame.scan = scan;
+		{
+			std::lock_guard<std::mutex> lock(sensor_mutex_);
+			frame.attitude = sensor_attitude_;
+			frame.odom = sensor_odom_;
+			frame.last_odom = sensor_last_odom_;
+		}
+		MinimizeScans(frame.cloud, &frame.pole_scans);
+		while (!estimation_queue_.Push(frame) && pipeline_running_) {	//wait for the filter instead of dropping
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+		return;
+	}
+	if (scan->intensities.size() > 0) {	//don't take scans from old laser
+		scan_ = scan;	//keep the message itself instead of copying it
 	}
 	else ROS_ERROR("Receiving empty laser messages");
 	SetTime();
+	//in event driven mode every scan runs through the filter exactly once
+	if (event_driven_ && !initiation_ && !scan_->ranges.empty()) ProcessScan();
 }
 
-void Loc::OdomCallback(const localization::IOFromBoard &odom) {
-	ROS_INFO("odom: right %d left %d", odom.deltaUmRight, odom.deltaUmLeft);
+void Loc::OdomCallback(const localization::IOFromBoard::ConstPtr &odom) {
+	localization_core::FlightRecord(localization_core::kFlightOdometry, 0, odom->deltaUmRight, odom->deltaUmLeft);
+	if (pipeline_running_) {
+		std::lock_guard<std::mutex> lock(sensor_mutex_);
+		sensor_last_odom_ = sensor_odom_;
+		sensor_odom_ = *odom;
+		return;
+	}
 	last_odom_ = odom_;
-	odom_ = odom;
+	odom_ = *odom;
 }
 
-void Loc::ImuCallback(const sensor_msgs::Imu &attitude) {
+void Loc::ImuCallback(const sensor_msgs::Imu::ConstPtr &attitude) {
 	//ROS_INFO("Callback");
-	attitude_.header = attitude.header;
+	sensor_msgs::Imu corrected;
+	corrected.header = attitude->header;
 	Eigen::Quaternion<double> rotate_helper;
-	const double x = attitude.orientation.x;
-	const double y = attitude.orientation.y;
-	const double z = attitude.orientation.z;
-	const double w = attitude.orientation.w;
+	const double x = attitude->orientation.x;
+	const double y = attitude->orientation.y;
+	const double z = attitude->orientation.z;
+	const double w = attitude->orientation.w;
 	rotate_helper = Eigen::Quaternion<double>(w,x,y,z);
 	Eigen::Quaternion<double> rot;
 	rot = Eigen::AngleAxis<double>(M_PI/2, Eigen::Vector3d(0,0,1));
 	rotate_helper *= rot;	//correct weird imu cs
 	rot = Eigen::AngleAxis<double>(M_PI/2, Eigen::Vector3d(0,1,0));
 	rotate_helper *= rot;	//rotate to sensor mount orientation
-	attitude_.orientation.x = rotate_helper.x();
-	attitude_.orientation.y = rotate_helper.y();
-	attitude_.orientation.z = rotate_helper.z();
-	attitude_.orientation.w = rotate_helper.w();
+	corrected.orientation.x = rotate_helper.x();
+	corrected.orientation.y = rotate_helper.y();
+	corrected.orientation.z = rotate_helper.z();
+	corrected.orientation.w = rotate_helper.w();
+	if (pipeline_running_) {
+		std::lock_guard<std::mutex> lock(sensor_mutex_);
+		sensor_attitude_ = corrected;
+	}
+	else attitude_ = corrected;
 	//remove yaw from orientation
-	geometry_msgs::Quaternion temp = attitude_.orientation;
+	geometry_msgs::Quaternion temp = corrected.orientation;
 	tf::Quaternion yaw_quat = tf::createQuaternionFromYaw(tf::getYaw(temp));
 	tf::Quaternion temp_quat;
 	tf::quaternionMsgToTF(temp, temp_quat);
@@ -307,41 +553,64 @@ void Loc::ImuCallback(const sensor_msgs::Imu &attitude) {
 	tf::Transform transform;
 	transform.setOrigin( tf::Vector3(0.0, 0.0, laser_height_ - 0.06));
 	transform.setRotation(temp_quat);
-	br.sendTransform(tf::StampedTransform(transform, attitude.header.stamp, "robot_frame", "imu_frame"));
+	br.sendTransform(tf::StampedTransform(transform, attitude->header.stamp, "robot_frame", "imu_frame"));
 	transform.setRotation(tf::Quaternion(0,0,0,1));
 	transform.setOrigin( tf::Vector3(0.013, 0.0, 0.06));
-	br.sendTransform(tf::StampedTransform(transform, attitude.header.stamp, "imu_frame", "laser_frame"));;
+	br.sendTransform(tf::StampedTransform(transform, attitude->header.stamp, "imu_frame", "laser_frame"));;
 }
 
 bool Loc::InitService(localization::InitLocalization::Request &req, localization::InitLocalization::Response &res) {
 	if(!initiation_ && req.init) {
+		StopPipeline();	//initiation runs single threaded
 		SetInit(true); 
 		//ROS_ERROR("initiation for localization commented out");
 		ros::Time begin = ros::Time::now();
-		while(initiation_ && ros::ok() && (ros::Time::now() - begin).sec < 15) {
+		while(initiation_ && Ok() && (ros::Time::now() - begin).sec < 15) {
 			pose_.pose.pose.position.x = -2000;	//for recognition if first time calculating
 			odom_.timestamp = 0;	//for recognition if no odometry data
 			last_odom_.timestamp = 0;
-			poles_.clear();
+			poles_.Clear();
 			StateHandler();
 		}
-		if ((ros::Time::now() - begin).sec < 15) {
-			ROS_ERROR("Initiation failed for 15 seconds");
-			res.success = false;
-		}
-		else {
-			res.success = true;
-		}
+		res.success = !initiation_;
+		if (!res.success) ROS_ERROR("Initiation did not finish within 15 seconds");
 	}
+	return true;
 }
 
-void Loc::SetTime() {
-	const double current_sec = scan_.header.stamp.toSec() + scan_.time_increment * scan_.ranges.size();
-	current_time_.fromSec(current_sec);	//use time of last scan measurement
+//writes the flight recorder to req.file, or to flight_recorder_file if empty
+bool Loc::DumpService(localization::DumpFlightRecorder::Request &req, localization::DumpFlightRecorder::Response &res) {
+	const std::string &file = req.file.empty() ? flight_recorder_file_ : req.file;
+	res.success = !file.empty() && localization_core::DumpFlightRecorder(file.c_str());
+	if (res.success) ROS_INFO("Dumped flight recorder to %s", file.c_str());
+	else ROS_ERROR("Could not dump flight recorder to \"%s\"", file.c_str());
+	return true;
+}
+
+void Loc::AppendPoints(const sensor_msgs::PointCloud &cloud, std::vector<Eigen::Vector3d> *points) {
+	for (int i = 0; i < cloud.points.size(); i++) {
+		points->push_back(Eigen::Vector3d(cloud.points[i].x, cloud.points[i].y, cloud.points[i].z));
+	}
 }
 
-int main(int argc, char **argv) {
-	ros::init(argc, argv, "localization");
-	Loc *loc = new Loc();
-	ROS_INFO("Location node shutting down!");
+localization_core::Pose2D Loc::ToPose2D(const geometry_msgs::Pose &pose) {
+	localization_core::Pose2D pose_2d;
+	pose_2d.x = pose.position.x;
+	pose_2d.y = pose.position.y;
+	pose_2d.theta = tf::getYaw(pose.orientation);
+	return pose_2d;
+}
+
+localization_core::RigidTransform Loc::ToRigidTransform(const tf::Transform &transform) {
+	localization_core::RigidTransform rigid;
+	const tf::Quaternion rotation = transform.getRotation();
+	const tf::Vector3 origin = transform.getOrigin();
+	rigid.rotation = Eigen::Quaterniond(rotation.w(), rotation.x(), rotation.y(), rotation.z());
+	rigid.translation = Eigen::Vector3d(origin.x(), origin.y(), origin.z());
+	return rigid;
+}
+
+void Loc::SetTime() {
+	const double current_sec = scan_->header.stamp.toSec() + scan_->time_increment * scan_->ranges.size();
+	current_time_.fromSec(current_sec);	//use time of last scan measurement
 }
@@ -1,3 +1,6 @@
+#ifndef LOCALIZATION_LOCATE_H
+#define LOCALIZATION_LOCATE_H
+
 #include "ros/ros.h"
 #include "sensor_msgs/LaserScan.h"
 #include "sensor_msgs/Imu.h"
@@ -7,26 +10,79 @@
 #include "geometry_msgs/PointStamped.h"
 #include "sensor_msgs/PointCloud.h"
 #include "visualization_msgs/Marker.h"
+#include "localization/DumpFlightRecorder.h"
 #include "localization/InitLocalization.h"
 #include "localization/IOFromBoard.h"
 #include "localization/beach_map.h"
 #include "tf/transform_datatypes.h"
 #include "tf/transform_broadcaster.h"
 #include "tf/transform_listener.h"
-#include "pole.cpp"
+#include "ros/callback_queue.h"
+#include "ros/spinner.h"
+#include "localization/core/association.h"
+#include "localization/core/beam_projector.h"
+#include "localization/core/find_poles.h"
+#include "localization/core/flight_recorder.h"
+#include "localization/core/geometry.h"
+#include "localization/core/get_pose.h"
+#include "localization/core/kalman.h"
+#include "localization/core/map_file.h"
+#include "localization/core/pole_store.h"
+#include "localization/core/relocalizer.h"
+#include "localization/core/scan_processing.h"
+#include "localization/intensity_params.h"
+#include "localization/spsc_queue.h"
+#include "localization/stage_trace.h"
+#ifdef LOCALIZATION_TRACING
+#include "diagnostic_msgs/DiagnosticArray.h"
+#endif
 #include <Eigen/Dense>
+#include <boost/shared_ptr.hpp>
+#include <atomic>
 #include <cmath>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
+//Localization node. Callbacks of n are served by the thread that calls Run, so Loc can run as
+//standalone node as well as inside a nodelet manager.
 class Loc {
  public:
-	Loc();
+	explicit Loc(const ros::NodeHandle &n);
+	~Loc();
+	//initiates and localizes until Shutdown is called or ros shuts down
+	void Run();
+	//lets Run return, may be called from any thread
+	void Shutdown();
 
  private:
-	ros::NodeHandle n_;
+	//one scan handed from the projection stage to the estimation stage
+	struct ScanFrame {
+		sensor_msgs::LaserScan::ConstPtr scan;
+		sensor_msgs::PointCloud cloud;
+		std::vector<Eigen::Vector3d> pole_scans;
+		sensor_msgs::Imu attitude;
+		localization::IOFromBoard odom;
+		localization::IOFromBoard last_odom;
+	};
+	//everything the publishing stage needs from one estimation step
+	struct PublishFrame {
+		sensor_msgs::PointCloud cloud;
+		geometry_msgs::PoseWithCovarianceStamped pose;
+		localization_core::PoleStore poles;
+		ros::Time time;
+	};
+
+	ros::NodeHandle n_;	//uses main_queue_
+	ros::CallbackQueue main_queue_;	//served by the thread in Run
+	std::atomic<bool> running_;
+	ros::NodeHandle sensor_n_;	//uses sensor_queue_
+	ros::NodeHandle scan_n_;	//uses scan_queue_
 	ros::Subscriber sub_scan_;
 	ros::Subscriber sub_odom_;
 	ros::Subscriber sub_imu_;
 	ros::ServiceServer srv_init_;
+	ros::ServiceServer srv_dump_;
 	ros::Publisher pub_pose_;
 	ros::Publisher pub_pole_;
 	ros::Publisher pub_map_;
@@ -37,11 +93,18 @@ class Loc {
 	double pole_radius;	//radius of reflective poles
 	double laser_height_;
 	bool use_odometry_;	//if using pioneer for testing
-	sensor_msgs::LaserScan scan_;
+	bool event_driven_;	//process every scan in its callback instead of polling at 25Hz
+	bool pipelined_;	//run sensors, estimation and publishing on separate threads
+	bool streaming_initiation_;	//fit the poles from running moments instead of the concatenated sweep cloud
+	std::string map_file_;	//map saved after initiation and loaded at startup, empty to always initiate
+	sensor_msgs::LaserScan::ConstPtr scan_;	//shared with the publisher, never modified
+	sensor_msgs::LaserScan::ConstPtr empty_scan_;	//scan_ after it has been processed
 	sensor_msgs::PointCloud cloud_;
+	std::vector<Eigen::Vector3d> pole_scans_;	//clustered pole points of cloud_
 	localization::IOFromBoard odom_;
 	localization::IOFromBoard last_odom_;
-	std::vector<Pole> poles_;
+	localization_core::PoleStore poles_;
+	localization_core::PoleMeasurements measurements_;	//visible part of poles_ for the update, keeps its capacity
 	geometry_msgs::PoseWithCovarianceStamped pose_;
 	geometry_msgs::PoseWithCovarianceStamped last_pose_;
 	geometry_msgs::PoseStamped initial_pose_;
@@ -50,44 +113,90 @@ class Loc {
 	sensor_msgs::Imu attitude_;
 	bool initiation_;
 	ros::Time current_time_;
-	double scan_covariance_;
-	double k_s_;
-	double k_th_;
+	localization_core::FilterParams filter_params_;	//scan_covariance, k_s, k_th, single_precision
+	localization_core::PoseFitParams pose_fit_params_;	//fit of the pose that seeds the filter
+	localization_core::IntensityClassifier classifier_;	//reflective beams from range and intensity
+	localization_core::BeamProjector projector_;	//keeps the beam tables between scans
+	std::vector<uint64_t> beam_mask_;
+	std::vector<Eigen::Vector3d> beam_points_;
+	std::vector<int> beam_indices_;
 	double laser_offset_;
 	tf::TransformListener listener_;
+	//pipeline
+	ros::CallbackQueue sensor_queue_;	//imu and odometry
+	ros::CallbackQueue scan_queue_;	//scan projection and clustering
+	boost::shared_ptr<ros::AsyncSpinner> sensor_spinner_;
+	boost::shared_ptr<ros::AsyncSpinner> scan_spinner_;
+	std::thread estimation_thread_;
+	std::thread publish_thread_;
+	std::atomic<bool> pipeline_running_;
+	SpscQueue<ScanFrame> estimation_queue_;	//frames are swapped through, so their buffers circulate
+	SpscQueue<PublishFrame> publish_queue_;
+	std::mutex sensor_mutex_;	//guards the sensor_* snapshots below while pipelined
+	sensor_msgs::Imu sensor_attitude_;
+	localization::IOFromBoard sensor_odom_;
+	localization::IOFromBoard sensor_last_odom_;
+	ScanFrame scan_frame_;	//filled by the scan stage, swapped into estimation_queue_
+	localization_core::ScanClusterer clusterer_;	//keeps its buffers between scans
+	localization_core::PoleAssociator associator_;	//keeps its pole index buffers between scans
+	localization_core::Relocalizer relocalizer_;	//triangle index of poles_, built after initiation
+	localization_core::RelocalizerParams relocalizer_params_;
+	int relocalize_after_;	//scans with pole points but less than 2 associated poles before relocalizing
+	int lost_scans_;
+	std::vector<Eigen::Vector3d> sweep_points_;	//pole points gathered during initiation
+	visualization_msgs::Marker pole_marker_;	//reused by PublishPoles
+	std::string flight_recorder_file_;	//flight recorder dump on a crash and by default of the dump service
+#ifdef LOCALIZATION_TRACING
+	ros::Publisher pub_trace_;
+	ros::WallTimer trace_timer_;
+	std::string trace_file_;	//chrome trace written on shutdown if set
+#endif
 
-	void NormalizeAngle(double& angle);
+	bool Ok() const;
 	void StateHandler();
 	void InitiatePoles();
-	void PublishPoles();
-	void PublishPose();
+	void PublishPoles(const localization_core::PoleStore &poles, const ros::Time &time);
+	void PublishPose(const geometry_msgs::PoseWithCovarianceStamped &pose);
 	void PublishMap();
-	void PublishTf();
+	void PublishTf(const geometry_msgs::PoseWithCovarianceStamped &pose, const ros::Time &time);
 	void PublishCloud(const sensor_msgs::PointCloud &cloud);
+	void PublishLines(const std::vector<localization_core::PoleLine> &lines, const std_msgs::Header &header);
 	void Locate();
+	void ProcessScan();
+	void SpinOnce();
+	void StartPipeline();
+	void StopPipeline();
+	void EstimationLoop();
+	void PublishLoop();
+#ifdef LOCALIZATION_TRACING
+	void PublishTrace(const ros::WallTimerEvent &event);
+#endif
 	void RefreshData();
 	void UpdatePoles(const std::vector<Eigen::Vector3d> &scans_to_sort);
 	void GetPose();
+	void FitPose(localization_core::Pose2D pose);
+	void ResetPose(const localization_core::Pose2D &pose);
+	bool StartFromStoredMap();
 	void EstimateInvisiblePoles();
+	void Relocalize(Eigen::Vector3d *state, Eigen::Matrix3d *covariance);
 	void PrintPose();
-	void CalcPose(const Pole &pole1, const Pole &pole2, std::vector<geometry_msgs::Pose> *pose_vector);
 	bool IsPolePoint(const double &intensity, const double &distance);
-	void MinimizeScans(std::vector<Eigen::Vector3d> *scan);
+	void MinimizeScans(const sensor_msgs::PointCloud &cloud, std::vector<Eigen::Vector3d> *scan);
 	void CorrectMoveError(std::vector<Eigen::Vector3d> *scan_pole_points);
-	void ScanToCloud();
-	void ScanCallback(const sensor_msgs::LaserScan &scan);
-	void OdomCallback(const localization::IOFromBoard &odom);
+	bool ScanToCloud(const sensor_msgs::LaserScan &scan, sensor_msgs::PointCloud *cloud);
+	void ScanCallback(const sensor_msgs::LaserScan::ConstPtr &scan);
+	void OdomCallback(const localization::IOFromBoard::ConstPtr &odom);
 	bool InitService(localization::InitLocalization::Request &req, localization::InitLocalization::Response &res);
-	void ImuCallback(const sensor_msgs::Imu &attitude);
+	bool DumpService(localization::DumpFlightRecorder::Request &req, localization::DumpFlightRecorder::Response &res);
+	void ImuCallback(const sensor_msgs::Imu::ConstPtr &attitude);
 	void SetInit(const bool &init);
 	//Kalman functions
 	void DoTheKalman();
 	void SetTime();
-	Eigen::Matrix3d StateJacobi(const double &ds, const double &dth, const double &theta);
-	Eigen::MatrixXd InputJacobi(const double &ds, const double &dth, const double &theta);
-	Eigen::Matrix2d Q(const double &ds, const double &dth);
-	Eigen::VectorXd EstimateReferencePoint(const std::vector<Pole> &visible_poles, const Eigen::Vector3d &state);
-	Eigen::MatrixXd EstimateJacobi(const std::vector<Pole> &visible_poles, const Eigen::Vector3d &state);
-	Eigen::MatrixXd ErrorMatrix(const std::vector<Pole> &visible_poles, const Eigen::Vector3d &state);
-	Eigen::VectorXd CalculateMeasuredPoints(const std::vector<Pole> &visible_poles);
+	//conversions between ros messages and the core library
+	static void AppendPoints(const sensor_msgs::PointCloud &cloud, std::vector<Eigen::Vector3d> *points);
+	static localization_core::Pose2D ToPose2D(const geometry_msgs::Pose &pose);
+	static localization_core::RigidTransform ToRigidTransform(const tf::Transform &transform);
 };
+
+#endif
@@ -1,117 +1,149 @@
-#include "locate_initiate.cpp"
+#include "locate.h"
 #include <algorithm>
 
-void Loc::NormalizeAngle(double& angle) {
-  while(angle > M_PI && ros::ok()) angle -= 2*M_PI;
-  while(angle < -M_PI && ros::ok()) angle += 2*M_PI;
-}
-
-void Loc::PublishPoles() {
+void Loc::PublishPoles(const localization_core::PoleStore &poles, const ros::Time &time) {
+	LOC_TRACE_SCOPE(kPublishPoles);
 	//ROS_INFO("Publishing poles...");
 	int j = 0;
-	visualization_msgs::Marker line_list;
-	for (int i = 0; i < poles_.size(); i++) {
-		line_list.header = cloud_.header;
+	visualization_msgs::Marker &line_list = pole_marker_;
+	line_list.points.clear();	//keeps the capacity of earlier calls
+	for (int i = 0; i < poles.size(); i++) {
+		line_list.header.stamp = time;
 		line_list.header.frame_id = "fixed_frame";
 		line_list.ns = "points_and_lines";
 		line_list.action = visualization_msgs::Marker::ADD;
 		line_list.pose.orientation.w = 1.0;
 		line_list.id = 0;
 		line_list.type = visualization_msgs::Marker::LINE_LIST;
-		line_list.scale.x = poles_[0].line().d;
+		line_list.scale.x = poles.line(0).d;
 		line_list.color.b = 1.0;
 		line_list.color.a = 1.0;
-		if(poles_[i].visible()) {
+		const bool visible = poles.visible(i);
+		if(visible) {
 			geometry_msgs::PointStamped point;
 			point.header.seq = 1;
-			point.header.stamp = current_time_;
+			point.header.stamp = time;
 			point.header.frame_id = "robot_frame";
-			Eigen::Vector3d temp_point;
-			temp_point = poles_[i].laser_coords();
-			point.point.x = temp_point.x();
-			point.point.y = temp_point.y();
-			point.point.z = temp_point.z();
+			point.point.x = poles.laser_x()[i];
+			point.point.y = poles.laser_y()[i];
+			point.point.z = poles.laser_z()[i];
 			pub_pole_.publish(point);
 		}
 		geometry_msgs::Point start, end;
-		start.x = poles_[i].line().p.x(); start.y = poles_[i].line().p.y(); start.z = poles_[i].line().p.z();
-		end.x = poles_[i].line().end.x(); end.y = poles_[i].line().end.y(); end.z = poles_[i].line().end.z();
+		const localization_core::PoleLine line = poles.line(i);
+		start.x = line.p.x(); start.y = line.p.y(); start.z = line.p.z();
+		end.x = line.end.x(); end.y = line.end.y(); end.z = line.end.z();
 		line_list.points.push_back(start);
 		line_list.points.push_back(end);
-		if (poles_[i].visible()) j++;
+		if (visible) j++;
 	}
 	pub_marker_.publish(line_list);
-	ROS_INFO("seeing %d poles", j);
+	localization_core::FlightRecord(localization_core::kFlightPoles, j, poles.size());
 	//ROS_INFO("Success!");
 }
 
 void Loc::PublishCloud(const sensor_msgs::PointCloud &cloud) {
+	LOC_TRACE_SCOPE(kPublishCloud);
 	pub_cloud_.publish(cloud);
 }
 
-void Loc::PublishPose() {
+//publishes the lines found during initiation in the laser frame
+void Loc::PublishLines(const std::vector<localization_core::PoleLine> &lines, const std_msgs::Header &header) {
+	visualization_msgs::Marker points, line_list;
+	points.header = line_list.header = header;
+	points.ns = line_list.ns = "points_and_lines";
+	points.action = line_list.action = visualization_msgs::Marker::ADD;
+	points.pose.orientation.w = line_list.pose.orientation.w = 1.0;
+	points.id = 0;
+	line_list.id = 2;
+	points.type = visualization_msgs::Marker::POINTS;
+	line_list.type = visualization_msgs::Marker::LINE_LIST;
+	points.scale.x = lines[0].d;
+	points.scale.y = lines[0].d;
+	line_list.scale.x = lines[0].d;	//TODO: make each pole different or use mean
+	points.color.g = 1.0f;
+	points.color.a = 1.0;
+	line_list.color.b = 1.0;
+	line_list.color.a = 1.0;
+	for (int i = 0; i < lines.size(); i++) {
+		geometry_msgs::Point point, start, end;
+		point.x = lines[i].p.x(); point.y = lines[i].p.y(); point.z = lines[i].p.z();
+		start.x = lines[i].p.x(); start.y = lines[i].p.y(); start.z = lines[i].p.z();
+		end.x = lines[i].end.x(); end.y = lines[i].end.y(); end.z = lines[i].end.z();
+		points.points.push_back(point);
+		line_list.points.push_back(start);
+		line_list.points.push_back(end);
+	}
+	pub_marker_.publish(points);
+	pub_marker_.publish(line_list);
+}
+
+void Loc::PublishPose(const geometry_msgs::PoseWithCovarianceStamped &pose) {
+	LOC_TRACE_SCOPE(kPublishPose);
 	//ROS_INFO("Publishing pose...");
 	geometry_msgs::PoseStamped temp_pose;
-	temp_pose.pose.position.x = pose_.pose.pose.position.x;
-	temp_pose.pose.position.y = pose_.pose.pose.position.y;
-	temp_pose.pose.orientation = pose_.pose.pose.orientation;
-	temp_pose.header = pose_.header;
+	temp_pose.pose.position.x = pose.pose.pose.position.x;
+	temp_pose.pose.position.y = pose.pose.pose.position.y;
+	temp_pose.pose.orientation = pose.pose.pose.orientation;
+	temp_pose.header = pose.header;
 	pub_pose_.publish(temp_pose);
 	//ROS_INFO("delay: %fms", (ros::Time::now()-current_time_).toSec()*1000);
 }
 	
-bool sortByAngle(Pole i, Pole j) {return atan2(i.laser_coords().y(), i.laser_coords().x())
-	 < atan2(j.laser_coords().y(), j.laser_coords().x());}
-
 void Loc::PublishMap() {
 	localization::beach_map beach_map;
-	std::vector<Pole> sorted_poles = poles_;
-	std::sort(sorted_poles.begin(), sorted_poles.end(), sortByAngle);
-	for (int i = 0; i < sorted_poles.size(); i++) {
+	std::vector<double> angle(poles_.size());
+	std::vector<int> order(poles_.size());
+	for (int i = 0; i < poles_.size(); i++) {
+		angle[i] = atan2(poles_.laser_y()[i], poles_.laser_x()[i]);
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&](const int &i, const int &j) {return angle[i] < angle[j];});
+	for (int k = 0; k < order.size(); k++) {
+		const localization_core::PoleLine pole_line = poles_.line(order[k]);
 		geometry_msgs::PointStamped point;
-		point.point.x = sorted_poles[i].line().p.x();
-		point.point.y = sorted_poles[i].line().p.y();
-		point.point.z = sorted_poles[i].line().p.z();
+		point.point.x = pole_line.p.x();
+		point.point.y = pole_line.p.y();
+		point.point.z = pole_line.p.z();
 		beach_map.poles.push_back(point);
 		localization::line line;
-		line.p.x = sorted_poles[i].line().p.x();
-		line.p.y = sorted_poles[i].line().p.y();
-		line.p.z = sorted_poles[i].line().p.z();
-		line.u.x = sorted_poles[i].line().u.x();
-		line.u.y = sorted_poles[i].line().u.y();
-		line.u.z = sorted_poles[i].line().u.z();
-		line.end.x = sorted_poles[i].line().end.x();
-		line.end.y = sorted_poles[i].line().end.y();
-		line.end.z = sorted_poles[i].line().end.z();
-		line.d = sorted_poles[i].line().d;
+		line.p.x = pole_line.p.x();
+		line.p.y = pole_line.p.y();
+		line.p.z = pole_line.p.z();
+		line.u.x = pole_line.u.x();
+		line.u.y = pole_line.u.y();
+		line.u.z = pole_line.u.z();
+		line.end.x = pole_line.end.x();
+		line.end.y = pole_line.end.y();
+		line.end.z = pole_line.end.z();
+		line.d = pole_line.d;
 		beach_map.lines.push_back(line);
 	}
-	beach_map.basestation.pose = pose_.pose.pose;
+	beach_map.basestation.pose = initial_pose_.pose;
 	double yaw = tf::getYaw(beach_map.basestation.pose.orientation);
 	beach_map.basestation.pose.position.x -= cos(yaw)*1.0;	//translate pose 1m against driving 
 	beach_map.basestation.pose.position.y -= sin(yaw)*1.0;	//direction to get pose of base station
 	pub_map_.publish(beach_map);
 }
 
-void Loc::PublishTf() {
+void Loc::PublishTf(const geometry_msgs::PoseWithCovarianceStamped &pose, const ros::Time &time) {
+	LOC_TRACE_SCOPE(kPublishTf);
 	static tf::TransformBroadcaster br;
 	tf::Transform transform;
-	transform.setOrigin( tf::Vector3(pose_.pose.pose.position.x, pose_.pose.pose.position.y, 0.0));
-	geometry_msgs::Quaternion quat = pose_.pose.pose.orientation;
+	transform.setOrigin( tf::Vector3(pose.pose.pose.position.x, pose.pose.pose.position.y, 0.0));
+	geometry_msgs::Quaternion quat = pose.pose.pose.orientation;
 	transform.setRotation(tf::Quaternion(quat.x, quat.y, quat.z, quat.w));
-	br.sendTransform(tf::StampedTransform(transform, current_time_, "fixed_frame", "robot_frame"));
+	br.sendTransform(tf::StampedTransform(transform, time, "fixed_frame", "robot_frame"));
 }
 
 void Loc::PrintPose() {
 	ROS_INFO("Estimate [%f %f] %f rad\n", pose_.pose.pose.position.x, pose_.pose.pose.position.y, tf::getYaw(pose_.pose.pose.orientation));
 }
 
-//function to fill the poles with data from the current laser scan
+//function to fill the poles with data from the current laser scan; pole_scans_ has to be clustered from cloud_
 void Loc::RefreshData() {
-	std::vector<Eigen::Vector3d> locate_scans;	
-	MinimizeScans(&locate_scans);	//get relevant scan points
-	CorrectMoveError(&locate_scans);	
-	UpdatePoles(locate_scans);		//assign scans to respective poles
+	CorrectMoveError(&pole_scans_);	
+	UpdatePoles(pole_scans_);		//assign scans to respective poles
 }
 
 void Loc::SetInit(const bool &init) {
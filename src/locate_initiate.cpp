@@ -1,21 +1,65 @@
-#include "locate_kalman.cpp"
-#include "find_poles.cpp"
-#include <laser_geometry/laser_geometry.h>
+#include "locate.h"
 #include <localization/serial_com.h>
+#include "localization/core/pole_accumulator.h"
+#include "localization/core/thread_pool.h"
+#include <chrono>
+#include <thread>
 
 void Loc::InitiatePoles() {
 	ROS_INFO("Gathering data...");
 	//Read parameters for initial scanning
 	std::string address;
-	double rev_time, roll_min, roll_max, pitch_min, pitch_max;
+	double rev_time, roll_min, roll_max, pitch_min, pitch_max, line_fit_keep, ack_timeout;
+	bool circle_diameter_fit, adaptive_sweep;
+	double sweep_min_time, sweep_max_time;
+	int sweep_poles;
+	localization_core::PoleConvergence convergence;
 	if (ros::param::get("address", address));	//get address from parameters
 	else {
 		address = "dev/ttyUSB0"; ROS_WARN("Did not find config for motor controller address!");
 	}
+	if (ros::param::get("ack_timeout", ack_timeout));	//get time to wait for the motor controller
+	else {
+		ack_timeout = 0.5; ROS_WARN("Did not find config for ack_timeout");
+	}
 	if (ros::param::get("T", rev_time));	//get revolution time
 	else {
 		rev_time = 5; ROS_WARN("Did not find config for revolution time");
 	}
+	if (ros::param::get("adaptive_sweep", adaptive_sweep));	//get whether the sweep stops on converged poles
+	else {
+		adaptive_sweep = false; ROS_WARN("Did not find config for adaptive_sweep");
+	}
+	if (ros::param::get("sweep_min_time", sweep_min_time));	//get shortest adaptive sweep
+	else {
+		sweep_min_time = 1.0; ROS_WARN("Did not find config for sweep_min_time");
+	}
+	if (ros::param::get("sweep_max_time", sweep_max_time));	//get longest adaptive sweep
+	else {
+		sweep_max_time = 2 * (rev_time + 1); ROS_WARN("Did not find config for sweep_max_time");
+	}
+	if (ros::param::get("sweep_poles", sweep_poles));	//get number of converged poles that ends the sweep
+	else {
+		sweep_poles = 0; ROS_WARN("Did not find config for sweep_poles");
+	}
+	int min_points;	//no long overload of param::get
+	if (ros::param::get("pole_min_points", min_points));	//get convergence limits of a pole
+	else {
+		min_points = 300; ROS_WARN("Did not find config for pole_min_points");
+	}
+	convergence.min_points = min_points;
+	if (ros::param::get("pole_min_height", convergence.min_z_coverage));
+	else {
+		convergence.min_z_coverage = 0.1; ROS_WARN("Did not find config for pole_min_height");
+	}
+	if (ros::param::get("pole_diameter_error", convergence.max_diameter_error));
+	else {
+		convergence.max_diameter_error = 0.005; ROS_WARN("Did not find config for pole_diameter_error");
+	}
+	if (ros::param::get("pole_tilt_error", convergence.max_tilt_error));
+	else {
+		convergence.max_tilt_error = 0.005; ROS_WARN("Did not find config for pole_tilt_error");
+	}
 	if (ros::param::get("roll_min", roll_min));	//get revolution time
 	else {
 		roll_min = -0.175; ROS_WARN("Did not find config for roll_min");
@@ -32,20 +76,81 @@ void Loc::InitiatePoles() {
 	else {
 		pitch_max = 0.193; ROS_WARN("Did not find config for pitch_max");
 	}
+	if (ros::param::get("line_fit_keep", line_fit_keep));	//get fraction of points for trimmed line fit
+	else {
+		line_fit_keep = 1.0; ROS_WARN("Did not find config for line_fit_keep");
+	}
+	if (ros::param::get("circle_diameter_fit", circle_diameter_fit));	//get diameter method
+	else {
+		circle_diameter_fit = false; ROS_WARN("Did not find config for circle_diameter_fit");
+	}
 	const double roll_amp = (roll_max - roll_min) / 2, pitch_amp = (pitch_max - pitch_min) / 2;	//angle amplitudes
 	const double roll_mid = (roll_max + roll_min) / 2, pitch_mid = (pitch_max + pitch_min) / 2;	//angle midpoints
-	SerialCom *serial_com = new SerialCom(address);	//open serial communication
+	SerialCom serial_com(address, ack_timeout);	//sends from its own thread, never blocks the sweep
+	if (!serial_com.IsOpen()) ROS_ERROR("Could not open motor controller at %s, sweeping without suspension", address.c_str());
 	ros::Duration(1.0).sleep();
-	sensor_msgs::PointCloud cloud;
+	const int kCommanded = 128;	//far more than can be in flight within ack_timeout
+	double commanded[kCommanded][2];	//roll and pitch by sequence number
+	double attitude[2] = {0, 0};	//last acknowledged roll and pitch, what the suspension is moving to
+	ros::Time attitude_time;
+	bool acknowledged = false;
+	localization_core::PoleAccumulator accumulator;
+	const bool streaming = streaming_initiation_ || adaptive_sweep;	//the adaptive sweep needs the running statistics
+	std::vector<localization_core::PoleStatistics> statistics;
+	sweep_points_.clear();	//keeps the capacity of an earlier initiation
 	ros::Time begin = ros::Time::now();
 	ros::Rate loop_rate(25);
-	while ((ros::Time::now() - begin).toSec() < (rev_time + 1) && ros::ok()) {	//gather data for T + 2 seconds
-		ros::spinOnce();	//get one scan and corresponding pointcloud
-		ScanToCloud();
-		cloud.points.insert(cloud.points.end(), cloud_.points.begin(), cloud_.points.end());
-		cloud.channels.insert(cloud.channels.end(), cloud_.channels.begin(), cloud_.channels.end());
-		cloud.header = cloud_.header;
-		PublishCloud(cloud);
+	while (Ok()) {	//gather data for T + 1 seconds, or until the poles are well defined
+		const double elapsed = (ros::Time::now() - begin).toSec();
+		if (!adaptive_sweep && elapsed >= rev_time + 1) break;
+		if (adaptive_sweep && elapsed >= sweep_min_time) {
+			accumulator.GetStatistics(&statistics);
+			int converged = 0;
+			for (int i = 0; i < statistics.size(); i++) if (statistics[i].Converged(convergence)) converged++;
+			const int under_observed = statistics.size() - converged;
+			if (statistics.size() > 1 && under_observed == 0) {
+				ROS_INFO("All %d poles converged after %f s", converged, elapsed);
+				break;
+			}
+			if (sweep_poles > 0 && converged >= sweep_poles) {
+				ROS_INFO("%d poles converged after %f s", converged, elapsed);
+				break;
+			}
+			if (elapsed >= rev_time + 1 && under_observed == 0) break;	//extend only for poles seen too little
+			if (elapsed >= sweep_max_time) {
+				ROS_WARN("%d of %lu poles still under-observed after %f s", under_observed, statistics.size(), elapsed);
+				break;
+			}
+		}
+		SpinOnce();	//get one scan and corresponding pointcloud
+		SerialCom::Ack ack;
+		while (serial_com.PollAck(&ack)) {
+			if (ack.timed_out) {
+				ROS_WARN("Motor controller did not acknowledge \"%s\"", ack.command.c_str());
+				continue;
+			}
+			attitude[0] = commanded[ack.seq % kCommanded][0];
+			attitude[1] = commanded[ack.seq % kCommanded][1];
+			attitude_time = ros::Time::now() - ros::Duration(std::chrono::duration<double>(SerialCom::Clock::now() - ack.acked).count());
+			acknowledged = true;
+		}
+		if (acknowledged) {
+			ROS_DEBUG("Scan at %f taken with roll %f pitch %f, acknowledged %f s before", scan_->header.stamp.toSec(),
+				attitude[0], attitude[1], (scan_->header.stamp - attitude_time).toSec());
+		}
+		ScanToCloud(*scan_, &cloud_);
+		if (streaming) {	//only keep running sums per pole
+			for (int i = 0; i < cloud_.points.size(); i++) {
+				accumulator.Add(cloud_.points[i].x, cloud_.points[i].y, cloud_.points[i].z);
+			}
+		}
+		else {
+			if (sweep_points_.empty()) {	//the sweep sees about as many points every scan
+				sweep_points_.reserve(cloud_.points.size() * (rev_time + 1) * 25 * 5 / 4);
+			}
+			AppendPoints(cloud_, &sweep_points_);
+		}
+		PublishCloud(cloud_);	//only the current scan, the sweep is shown by the fitted lines
 		//set new laser angle
 		const double current = (ros::Time::now() - begin).toSec();
 		const double roll = roll_mid + roll_amp * sin(current / rev_time * 2 * M_PI);
@@ -53,19 +158,43 @@ void Loc::InitiatePoles() {
 		const int roll_data = -roll * 1000 / M_PI * 180;	//controller wants degree*1000
 		const int pitch_data = pitch * 1000 / M_PI * 180;	
 		std::string data = "set roll ";
-		stringstream ss;
+		std::stringstream ss;
 		ss << roll_data << " pitch " << pitch_data;
 		data.append(ss.str());
-		ROS_INFO("%s", data.c_str());
-		serial_com->Send(data);
+		ROS_DEBUG("%s", data.c_str());
+		const uint64_t seq = serial_com.Send(data);
+		if (seq) {
+			commanded[seq % kCommanded][0] = roll;
+			commanded[seq % kCommanded][1] = pitch;
+		}
 		loop_rate.sleep();
 	}
-	serial_com->Send("set roll 0 pitch 0");	//reset laser pose ot start localization and control
+	serial_com.Send("set roll 0 pitch 0");	//reset laser pose ot start localization and control
 	ros::Duration(1.0).sleep();	//give suspension time to go to zero position
-	//delete serial_com;
-	FindPoles find_poles(cloud);
-	find_poles.CalcPoles();
-	std::vector<Pole::Line> lines = find_poles.GetPoles();
+	std::vector<localization_core::PoleLine> lines;
+	if (adaptive_sweep) {
+		accumulator.GetStatistics(&statistics);
+		for (int i = 0; i < statistics.size(); i++) {
+			ROS_DEBUG("pole %d: %ld points, residual %f, diameter variance %f, height %f, diameter error %f, tilt error %f",
+				i, statistics[i].count, statistics[i].residual, statistics[i].diameter_variance, statistics[i].z_coverage,
+				statistics[i].diameter_error, statistics[i].tilt_error);
+		}
+	}
+	if (streaming) {
+		ROS_INFO("Accumulated %ld points", accumulator.points());
+		lines = accumulator.GetPoles();
+	}
+	else {
+		ROS_INFO("Gathered %lu points", sweep_points_.size());
+		localization_core::ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+		localization_core::FindPoles find_poles(sweep_points_);
+		find_poles.SetThreadPool(&pool);	//fit poles in parallel
+		find_poles.SetLineFitKeep(line_fit_keep);
+		if (circle_diameter_fit) find_poles.SetDiameterMethod(localization_core::FindPoles::kDiameterCircle);
+		find_poles.CalcPoles();
+		lines = find_poles.GetPoles();
+	}
+	if (!lines.empty()) PublishLines(lines, cloud_.header);
 	if (lines.size() > 1) {
 		Eigen::Vector3d translate(lines[0].p.x(), lines[0].p.y(), 0);	//translate vector to make pole 0 [0 0]
 		Eigen::Vector3d second = lines[1].p - translate;
@@ -80,60 +209,102 @@ void Loc::InitiatePoles() {
 			lines[i].p = rotate * lines[i].p;
 			lines[i].end = rotate * lines[i].end;
 			lines[i].u = rotate * lines[i].u;
-			Pole temp_pole(lines[i], scan_point, current_time_, i);
-			poles_.push_back(temp_pole);
+			poles_.Add(lines[i], scan_point, current_time_.toSec());
 			ROS_INFO("base for pole %d [%f %f %f]", i, lines[i].p.x(), lines[i].p.y(), lines[i].p.z() );
 		}
-		PublishPoles();
+		PublishPoles(poles_, current_time_);
+		relocalizer_.Index(poles_, relocalizer_params_);
+		lost_scans_ = 0;
 		SetInit(false);
 	}
 	else ROS_WARN("Only found %lu poles. At least 2 needed.", lines.size());
 	//get first initial pose for kalman filter
+	MinimizeScans(cloud_, &pole_scans_);
 	RefreshData();
 	GetPose();
 	initial_pose_.pose = pose_.pose.pose;
 	initial_pose_.header = pose_.header;
 	EstimateInvisiblePoles();
 	//PrintPose();
-	PublishPoles();
-	PublishPose();
+	PublishPoles(poles_, current_time_);
+	PublishPose(pose_);
 	PublishMap();
+	if (!initiation_ && !map_file_.empty()) {	//found a map, keep it for the next start
+		if (localization_core::SaveMap(map_file_, poles_, ToPose2D(initial_pose_.pose))) {
+			ROS_INFO("Saved %d poles to %s", poles_.size(), map_file_.c_str());
+		}
+	}
 	loop_rate.sleep();
 }
 
-void Loc::GetPose() {
-	Eigen::Vector2d x(0,0), x_old(2000,2000);
-	while ( (x_old - x).norm() > 0.01 && ros::ok() ) {
-		x_old = x;
-		Eigen::MatrixXd jacobi(poles_.size(), 2);
-		Eigen::VectorXd f_x(poles_.size() );
-		Eigen::VectorXd c(poles_.size() );
-		for (int i = 0; i < poles_.size(); i++) {
-			Eigen::Vector2d x_p( poles_[i].line().p.x(), poles_[i].line().p.y());
-			Eigen::Vector2d x_m( poles_[i].laser_coords().x(), poles_[i].laser_coords().y());
-			jacobi(i, 0) = 2 * x_old.x() - 2 * x_p.x();
-			jacobi(i, 1) = 2 * x_old.y() - 2 * x_p.y();
-			f_x(i) = (x_p.x() - x_old.x() ) * (x_p.x() - x_old.x() ) + (x_p.y() - x_old.y() ) * (x_p.y() - x_old.y() );
-			c(i) = x_m.x() * x_m.x() + x_m.y() * x_m.y();
+//loads the map of an earlier initiation and fixes the pose from single scans instead of sweeping;
+//false if there is no valid map or the scans of the first second do not match it
+bool Loc::StartFromStoredMap() {
+	localization_core::Pose2D initial_pose;
+	if (!localization_core::LoadMap(map_file_, &poles_, &initial_pose)) return false;
+	ROS_INFO("Loaded %d poles from %s", poles_.size(), map_file_.c_str());
+	relocalizer_.Index(poles_, relocalizer_params_);
+	localization_core::Pose2D pose;
+	bool found = false;
+	ros::Time begin = ros::Time::now();
+	ros::Rate loop_rate(25);
+	while (!found && Ok() && (ros::Time::now() - begin).toSec() < 1.0) {
+		SpinOnce();
+		if (!scan_->ranges.empty() && ScanToCloud(*scan_, &cloud_)) {
+			MinimizeScans(cloud_, &pole_scans_);
+			//most pole points have to belong to the stored map, otherwise the poles were moved
+			found = relocalizer_.Relocalize(pole_scans_, &pose)
+				&& 2 * relocalizer_.matches() > static_cast<int>(pole_scans_.size());
 		}
-		x += jacobi.colPivHouseholderQr().solve(c - f_x);
-		ROS_INFO("iter");
-	}	
-	ROS_INFO("initial pos [%f %f]", x.x(), x.y() );
-	double theta = 0;
-	for (int i = 0; i < poles_.size(); i++) {	//average over all results
-		Eigen::Vector2d x_p( poles_[i].line().p.x(), poles_[i].line().p.y());
-		Eigen::Vector2d x_m( poles_[i].laser_coords().x(), poles_[i].laser_coords().y());
-		const double cur_theta = atan2( x_p.y() - x.y(), x_p.x() - x.x() ) - atan2( x_m.y(), x_m.x() );
-		ROS_INFO("cur_theta %f", cur_theta);
-		theta += cur_theta;
-	}
-	theta /= poles_.size();
-	ROS_INFO("theta %f", theta);
-	pose_.pose.pose.position.x = x.x();
-	pose_.pose.pose.position.y = x.y();
+		if (!found) loop_rate.sleep();
+	}
+	if (!found) {
+		ROS_WARN("Stored map %s does not match the scans, initiating", map_file_.c_str());
+		poles_.Clear();
+		return false;
+	}
+	ROS_INFO("Found stored map in %d of %lu pole points", relocalizer_.matches(), pole_scans_.size());
+	associator_.Associate(pole_scans_, pose, cloud_.header.stamp.toSec(), &poles_);
+	FitPose(pose);	//warm start from the relocalized pose
+	EstimateInvisiblePoles();
+	initial_pose_.pose.position.x = initial_pose.x;	//base station of the stored map
+	initial_pose_.pose.position.y = initial_pose.y;
+	initial_pose_.pose.position.z = 0;
+	initial_pose_.pose.orientation = tf::createQuaternionMsgFromYaw(initial_pose.theta);
+	initial_pose_.header = pose_.header;
+	PublishPoles(poles_, current_time_);
+	PublishPose(pose_);
+	PublishMap();
+	lost_scans_ = 0;
+	SetInit(false);
+	return true;
+}
+
+//fits pose_ to the visible poles starting from the guess without a prior
+void Loc::GetPose() {
+	FitPose(localization_core::GetPose(poles_));
+}
+
+//fits pose_ and its covariance to the visible poles, starting from pose
+void Loc::FitPose(localization_core::Pose2D pose) {
+	Eigen::Matrix3d covariance;
+	const bool fitted = localization_core::FitPose(poles_, pose_fit_params_, &pose, &covariance);
+	if (!fitted) ROS_WARN("Pose fit failed with %d visible poles, using the guess", poles_.CountVisible());
+	ROS_INFO("initial pose [%f %f] %f rad", pose.x, pose.y, pose.theta);
+	ResetPose(pose);
+	if (fitted) {
+		pose_.pose.covariance[0] = covariance(0,0);
+		pose_.pose.covariance[7] = covariance(1,1);
+		pose_.pose.covariance[35] = covariance(2,2);
+	}
+}
+
+//sets pose_ with the covariance of a fresh start
+void Loc::ResetPose(const localization_core::Pose2D &pose) {
+	pose_.pose.pose.position.x = pose.x;
+	pose_.pose.pose.position.y = pose.y;
 	pose_.pose.pose.position.z = 0;
-	pose_.pose.pose.orientation = tf::createQuaternionMsgFromYaw(theta);
+	pose_.pose.pose.orientation = tf::createQuaternionMsgFromYaw(pose.theta);
 	pose_.header.seq = 1;
 	pose_.header.stamp = current_time_;
 	pose_.header.frame_id = "fixed_frame";
@@ -0,0 +1,9 @@
+#include "locate.h"
+
+int main(int argc, char **argv) {
+	ros::init(argc, argv, "localization");
+	Loc *loc = new Loc(ros::NodeHandle());
+	loc->Run();
+	ROS_INFO("Location node shutting down!");
+	delete loc;
+}
@@ -0,0 +1,55 @@
+//Stand-in for the motor controller of the laser suspension on a pseudo terminal, without ROS.
+//Prints the terminal to use as address and answers every command line with "ok <command>".
+//usage: motor_controller_sim [delay of every reply in ms] [every nth command stays unanswered]
+#define _XOPEN_SOURCE 600
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <termios.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+	const int delay_ms = argc > 1 ? std::atoi(argv[1]) : 0;
+	const int drop_every = argc > 2 ? std::atoi(argv[2]) : 0;
+	const int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+		std::fprintf(stderr, "could not open a pseudo terminal: %s\n", std::strerror(errno));
+		return 1;
+	}
+	termios tty;	//raw, the controller does not echo
+	tcgetattr(master, &tty);
+	cfmakeraw(&tty);
+	tcsetattr(master, TCSANOW, &tty);
+	std::printf("%s\n", ptsname(master));
+	std::fflush(stdout);
+	std::string line;
+	long commands = 0;
+	char buffer[256];
+	while (true) {
+		const ssize_t n = read(master, buffer, sizeof(buffer));
+		if (n < 0 && errno == EIO) {	//no one has the terminal open
+			usleep(10000);
+			continue;
+		}
+		if (n <= 0) break;
+		for (int i = 0; i < n; i++) {
+			if (buffer[i] != '\n') {
+				line.push_back(buffer[i]);
+				continue;
+			}
+			commands++;
+			std::fprintf(stderr, "%s\n", line.c_str());
+			if (drop_every <= 0 || commands % drop_every != 0) {
+				if (delay_ms > 0) usleep(delay_ms * 1000);
+				const std::string reply = "ok " + line + "\r\n";
+				if (write(master, reply.data(), reply.size()) < 0) break;
+			}
+			line.clear();
+		}
+	}
+	close(master);
+	return 0;
+}
@@ -0,0 +1,54 @@
+#include "laser_angle.h"
+#include "laser_filter.h"
+#include "locate.h"
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/shared_ptr.hpp>
+#include <thread>
+
+//Nodelet versions of laser_filter, locate and laser_angle. Loaded into one manager they hand the
+//scans over as shared pointers, without serialization or copies. The executables stay for debugging.
+namespace localization {
+
+class LaserFilterNodelet : public nodelet::Nodelet {
+ private:
+	boost::shared_ptr<GenericLaserScanFilterNode> filter_;
+
+	virtual void onInit() {
+		filter_.reset(new GenericLaserScanFilterNode(getNodeHandle(), getPrivateNodeHandle()));
+	}
+};
+
+//Loc blocks in its state loop, so it runs on its own thread and serves its own callback queue
+class LocateNodelet : public nodelet::Nodelet {
+ public:
+	virtual ~LocateNodelet() {
+		if (!loc_) return;
+		loc_->Shutdown();
+		if (thread_.joinable()) thread_.join();
+	}
+
+ private:
+	boost::shared_ptr<Loc> loc_;
+	std::thread thread_;
+
+	virtual void onInit() {
+		loc_.reset(new Loc(getNodeHandle()));
+		thread_ = std::thread(&Loc::Run, loc_.get());
+	}
+};
+
+class LaserAngleNodelet : public nodelet::Nodelet {
+ private:
+	boost::shared_ptr<LaserAngle> laser_angle_;
+
+	virtual void onInit() {
+		laser_angle_.reset(new LaserAngle(getNodeHandle()));
+	}
+};
+
+}	//namespace localization
+
+PLUGINLIB_EXPORT_CLASS(localization::LaserFilterNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(localization::LocateNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(localization::LaserAngleNodelet, nodelet::Nodelet)
@@ -0,0 +1,226 @@
+#include "localization/serial_com.h"
+#include "localization/core/log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+using localization_core::Log;
+using localization_core::kLogDebug;
+using localization_core::kLogError;
+using localization_core::kLogWarn;
+
+namespace {
+
+const int kQueueSize = 64;	//commands and acks in flight between the threads
+const int kIdlePollMs = 100;	//the I/O thread wakes at least this often to check timeouts and shutdown
+const std::size_t kMaxReply = 1024;	//longer replies are cut
+const std::size_t kLateReplies = 64;	//timed out commands whose late replies are recognized
+
+bool Delimits(const char &c) {
+	return c == ' ' || c == '\t' || c == ',' || c == ';' || c == ':';
+}
+
+//true if reply echoes the whole command: at its end or followed by a delimiter, so "set roll 1" is not
+//taken as the echo of "set roll 10" and the other way round
+bool Echoes(const std::string &reply, const std::string &command) {
+	if (command.empty()) return false;
+	for (std::size_t at = reply.find(command); at != std::string::npos; at = reply.find(command, at + 1)) {
+		const std::size_t end = at + command.size();
+		if ((at == 0 || Delimits(reply[at - 1])) && (end == reply.size() || Delimits(reply[end]))) return true;
+	}
+	return false;
+}
+
+}	//namespace
+
+SerialCom::SerialCom(const std::string &address, const double &ack_timeout) : fd_(-1),
+	ack_timeout_(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(ack_timeout))),
+	next_seq_(1), running_(true), outstanding_(0), unwritten_(0), commands_(kQueueSize), acks_(kQueueSize),
+	written_(0), writing_seq_(0) {
+	wake_[0] = wake_[1] = -1;
+	if (!Open(address)) return;
+	if (pipe(wake_) != 0 || fcntl(wake_[0], F_SETFL, O_NONBLOCK) != 0 || fcntl(wake_[1], F_SETFL, O_NONBLOCK) != 0) {
+		Log(kLogError, "could not create the wake pipe of the serial thread: %s", std::strerror(errno));
+		close(fd_);
+		fd_ = -1;
+		return;
+	}
+	thread_ = std::thread(&SerialCom::Loop, this);
+}
+
+SerialCom::~SerialCom() {
+	if (thread_.joinable()) {
+		const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(100);
+		while (unwritten_.load(std::memory_order_acquire) > 0 && Clock::now() < deadline) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		running_ = false;
+		const char wake = 0;
+		if (write(wake_[1], &wake, 1) < 0) {}	//the thread also wakes by its poll timeout
+		thread_.join();
+	}
+	for (int i = 0; i < 2; i++) if (wake_[i] >= 0) close(wake_[i]);
+	if (fd_ >= 0) close(fd_);
+}
+
+bool SerialCom::Open(const std::string &address) {
+	fd_ = open(address.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd_ < 0) {
+		Log(kLogError, "could not open serial port %s: %s", address.c_str(), std::strerror(errno));
+		return false;
+	}
+	termios tty;
+	bool ok = tcgetattr(fd_, &tty) == 0;
+	if (ok) {
+		cfmakeraw(&tty);	//8 data bits, no parity, no echo, no line editing
+		tty.c_cflag &= ~(CSTOPB | CRTSCTS);	//1 stop bit, no hardware flow control
+		tty.c_cflag |= CLOCAL | CREAD;
+		tty.c_cc[VMIN] = 0;	//reads return what is there
+		tty.c_cc[VTIME] = 0;
+		ok = cfsetispeed(&tty, B115200) == 0 && cfsetospeed(&tty, B115200) == 0 && tcsetattr(fd_, TCSANOW, &tty) == 0;
+	}
+	if (!ok) {
+		Log(kLogError, "could not configure serial port %s: %s", address.c_str(), std::strerror(errno));
+		close(fd_);
+		fd_ = -1;
+		return false;
+	}
+	tcflush(fd_, TCIOFLUSH);	//drop what the controller sent before
+	return true;
+}
+
+uint64_t SerialCom::Send(const std::string &data) {
+	if (fd_ < 0) return 0;
+	Command command;
+	command.seq = next_seq_;
+	command.line = data + "\n";
+	outstanding_.fetch_add(1, std::memory_order_release);	//before the push, the I/O thread may finish it at once
+	unwritten_.fetch_add(1, std::memory_order_release);
+	if (!commands_.Push(command)) {
+		outstanding_.fetch_sub(1, std::memory_order_release);
+		unwritten_.fetch_sub(1, std::memory_order_release);
+		Log(kLogWarn, "serial queue full, dropped \"%s\"", data.c_str());
+		return 0;
+	}
+	const char wake = 0;
+	if (write(wake_[1], &wake, 1) < 0) {}	//pipe full means the thread is awake anyway
+	return next_seq_++;
+}
+
+bool SerialCom::PollAck(Ack *ack) {
+	return acks_.Pop(ack);
+}
+
+void SerialCom::Loop() {
+	while (running_) {
+		if (written_ == write_buffer_.size()) {	//take the next command
+			Command command;
+			if (commands_.Pop(&command)) {
+				write_buffer_.swap(command.line);
+				written_ = 0;
+				writing_seq_ = command.seq;
+			}
+		}
+		int timeout = kIdlePollMs;
+		if (!in_flight_.empty()) {	//wake for the oldest timeout
+			const Clock::duration left = in_flight_.front().sent + ack_timeout_ - Clock::now();
+			timeout = std::max<long>(0, std::min<long>(timeout,
+				std::chrono::duration_cast<std::chrono::milliseconds>(left).count() + 1));
+		}
+		pollfd fds[2];
+		fds[0].fd = fd_;
+		fds[0].events = POLLIN | (written_ < write_buffer_.size() ? POLLOUT : 0);
+		fds[1].fd = wake_[0];
+		fds[1].events = POLLIN;
+		const int ready = poll(fds, 2, timeout);
+		if (ready < 0 && errno != EINTR) {
+			Log(kLogError, "serial poll failed: %s", std::strerror(errno));
+			break;
+		}
+		if (ready > 0) {
+			if (fds[1].revents & POLLIN) {
+				char drain[64];
+				while (read(wake_[0], drain, sizeof(drain)) > 0) {}
+			}
+			if (fds[0].revents & POLLOUT) Write();
+			if (fds[0].revents & POLLIN) Read();
+			else if (fds[0].revents & (POLLERR | POLLHUP)) {	//controller gone, keep timing out commands
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+		}
+		const Clock::time_point now = Clock::now();
+		while (!in_flight_.empty() && now - in_flight_.front().sent > ack_timeout_) Acknowledge("", true);
+	}
+}
+
+void SerialCom::Write() {
+	const ssize_t n = write(fd_, write_buffer_.data() + written_, write_buffer_.size() - written_);
+	if (n < 0) {
+		if (errno != EAGAIN && errno != EINTR) Log(kLogError, "serial write failed: %s", std::strerror(errno));
+		return;
+	}
+	written_ += n;
+	if (written_ < write_buffer_.size()) return;
+	InFlight command;
+	command.seq = writing_seq_;
+	command.command.assign(write_buffer_, 0, write_buffer_.size() - 1);	//without the newline
+	command.sent = Clock::now();
+	in_flight_.push_back(command);
+	unwritten_.fetch_sub(1, std::memory_order_release);
+}
+
+void SerialCom::Read() {
+	char buffer[256];
+	ssize_t n;
+	while ((n = read(fd_, buffer, sizeof(buffer))) > 0) {
+		for (int i = 0; i < n; i++) {
+			if (buffer[i] != '\n') {
+				if (read_buffer_.size() < kMaxReply) read_buffer_.push_back(buffer[i]);
+				continue;
+			}
+			if (!read_buffer_.empty() && read_buffer_[read_buffer_.size() - 1] == '\r') {
+				read_buffer_.erase(read_buffer_.size() - 1);
+			}
+			//a reply that echoes a later command means the replies of the ones before it were lost
+			std::size_t echoed = 0;
+			while (echoed < in_flight_.size() && !Echoes(read_buffer_, in_flight_[echoed].command)) echoed++;
+			if (echoed < in_flight_.size()) {
+				for (std::size_t j = 0; j <= echoed; j++) Acknowledge(j == echoed ? read_buffer_ : "", j < echoed);
+			}
+			else if (!in_flight_.empty() && !Late(read_buffer_)) Acknowledge(read_buffer_, false);
+			else Log(kLogDebug, "unsolicited reply from motor controller: %s", read_buffer_.c_str());
+			read_buffer_.clear();
+		}
+	}
+	if (n < 0 && errno != EAGAIN && errno != EINTR) Log(kLogError, "serial read failed: %s", std::strerror(errno));
+}
+
+//true if reply echoes a command that already timed out
+bool SerialCom::Late(const std::string &reply) const {
+	for (std::size_t i = 0; i < timed_out_.size(); i++) {
+		if (Echoes(reply, timed_out_[i])) return true;
+	}
+	return false;
+}
+
+//acknowledges the oldest command in flight
+void SerialCom::Acknowledge(const std::string &reply, const bool &timed_out) {
+	Ack ack;
+	ack.seq = in_flight_.front().seq;
+	ack.command.swap(in_flight_.front().command);
+	ack.reply = reply;
+	ack.timed_out = timed_out;
+	ack.sent = in_flight_.front().sent;
+	ack.acked = Clock::now();
+	in_flight_.pop_front();
+	if (timed_out) {
+		if (timed_out_.size() == kLateReplies) timed_out_.pop_front();
+		timed_out_.push_back(ack.command);
+	}
+	if (!acks_.Push(ack)) Log(kLogWarn, "serial ack queue full, dropped the ack of \"%s\"", ack.command.c_str());
+	outstanding_.fetch_sub(1, std::memory_order_release);
+}
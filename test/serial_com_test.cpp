@@ -0,0 +1,217 @@
+//SerialCom against a pseudo terminal whose master side plays the motor controller, no ROS needed.
+#include "localization/serial_com.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <string>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+const int kWaitMs = 2000;	//for anything that should happen at once
+
+class SerialComTest : public ::testing::Test {
+ protected:
+	SerialComTest() : master_(-1) {}
+
+	virtual void SetUp() {
+		master_ = posix_openpt(O_RDWR | O_NOCTTY);
+		ASSERT_GE(master_, 0);
+		ASSERT_EQ(0, grantpt(master_));
+		ASSERT_EQ(0, unlockpt(master_));
+		termios tty;	//raw, the controller does not echo
+		ASSERT_EQ(0, tcgetattr(master_, &tty));
+		cfmakeraw(&tty);
+		ASSERT_EQ(0, tcsetattr(master_, TCSANOW, &tty));
+		ASSERT_EQ(0, fcntl(master_, F_SETFL, O_NONBLOCK));
+		address_ = ptsname(master_);
+	}
+
+	virtual void TearDown() {
+		if (master_ >= 0) close(master_);
+	}
+
+	//next command line the controller gets, without the newline; reads at most chunk bytes at a time
+	bool ReadCommand(std::string *line, const std::size_t &chunk = 256) {
+		const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(kWaitMs);
+		while (true) {
+			const std::size_t end = pending_.find('\n');
+			if (end != std::string::npos) {
+				line->assign(pending_, 0, end);
+				pending_.erase(0, end + 1);
+				return true;
+			}
+			const int left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+			if (left <= 0) return false;
+			pollfd fd;
+			fd.fd = master_;
+			fd.events = POLLIN;
+			if (poll(&fd, 1, left) <= 0) continue;
+			char buffer[256];
+			const ssize_t n = read(master_, buffer, std::min(chunk, sizeof(buffer)));
+			if (n > 0) pending_.append(buffer, n);
+		}
+	}
+
+	void Reply(const std::string &data) {
+		std::size_t written = 0;
+		while (written < data.size()) {
+			const ssize_t n = write(master_, data.data() + written, data.size() - written);
+			if (n > 0) written += n;
+			else ASSERT_EQ(EAGAIN, errno);
+		}
+	}
+
+	static bool WaitAck(SerialCom *serial, SerialCom::Ack *ack, const int &wait_ms = kWaitMs) {
+		const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(wait_ms);
+		while (!serial->PollAck(ack)) {
+			if (Clock::now() > deadline) return false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return true;
+	}
+
+	typedef SerialCom::Clock Clock;
+	int master_;
+	std::string address_;
+	std::string pending_;	//read from the master, not yet a whole line
+};
+
+TEST_F(SerialComTest, AcknowledgesInOrder) {
+	SerialCom serial(address_, 1.0);
+	ASSERT_TRUE(serial.IsOpen());
+	const char *commands[] = {"set roll 1 pitch 0", "set roll 2 pitch 0", "set roll 3 pitch 0"};
+	uint64_t seq[3];
+	for (int i = 0; i < 3; i++) {
+		seq[i] = serial.Send(commands[i]);
+		ASSERT_NE(0u, seq[i]);
+	}
+	for (int i = 0; i < 3; i++) {
+		std::string line;
+		ASSERT_TRUE(ReadCommand(&line));
+		EXPECT_EQ(commands[i], line);
+		Reply("ok " + line + "\r\n");
+	}
+	for (int i = 0; i < 3; i++) {
+		SerialCom::Ack ack;
+		ASSERT_TRUE(WaitAck(&serial, &ack));
+		EXPECT_EQ(seq[i], ack.seq);
+		EXPECT_EQ(commands[i], ack.command);
+		EXPECT_EQ(std::string("ok ") + commands[i], ack.reply);
+		EXPECT_FALSE(ack.timed_out);
+		EXPECT_LE(ack.sent, ack.acked);
+	}
+	EXPECT_EQ(0, serial.Outstanding());
+}
+
+TEST_F(SerialComTest, TimesOutWithoutReply) {
+	SerialCom serial(address_, 0.05);
+	const uint64_t seq = serial.Send("set roll 5 pitch 5");
+	std::string line;
+	ASSERT_TRUE(ReadCommand(&line));
+	SerialCom::Ack ack;
+	ASSERT_TRUE(WaitAck(&serial, &ack));
+	EXPECT_EQ(seq, ack.seq);
+	EXPECT_TRUE(ack.timed_out);
+	EXPECT_TRUE(ack.reply.empty());
+	EXPECT_GE(ack.acked - ack.sent, std::chrono::milliseconds(50));
+	EXPECT_EQ(0, serial.Outstanding());
+}
+
+TEST_F(SerialComTest, DropsLateReply) {
+	SerialCom serial(address_, 0.05);
+	serial.Send("set roll 1 pitch 0");
+	std::string line;
+	ASSERT_TRUE(ReadCommand(&line));
+	SerialCom::Ack ack;
+	ASSERT_TRUE(WaitAck(&serial, &ack));
+	ASSERT_TRUE(ack.timed_out);
+	const uint64_t seq = serial.Send("set roll 2 pitch 0");
+	ASSERT_TRUE(ReadCommand(&line));
+	Reply("ok set roll 1 pitch 0\r\n");	//the late one must not acknowledge the command in flight
+	Reply("ok set roll 2 pitch 0\r\n");
+	ASSERT_TRUE(WaitAck(&serial, &ack));
+	EXPECT_EQ(seq, ack.seq);
+	EXPECT_FALSE(ack.timed_out);
+	EXPECT_EQ("ok set roll 2 pitch 0", ack.reply);
+	EXPECT_FALSE(WaitAck(&serial, &ack, 100));
+}
+
+TEST_F(SerialComTest, ResyncsAfterDroppedReply) {
+	SerialCom serial(address_, 5.0);
+	const uint64_t lost = serial.Send("set roll 1 pitch 0");
+	const uint64_t seq = serial.Send("set roll 2 pitch 0");
+	std::string line;
+	ASSERT_TRUE(ReadCommand(&line));
+	ASSERT_TRUE(ReadCommand(&line));
+	Reply("ok set roll 2 pitch 0\r\n");
+	SerialCom::Ack ack;
+	ASSERT_TRUE(WaitAck(&serial, &ack));
+	EXPECT_EQ(lost, ack.seq);
+	EXPECT_TRUE(ack.timed_out);
+	ASSERT_TRUE(WaitAck(&serial, &ack));
+	EXPECT_EQ(seq, ack.seq);
+	EXPECT_FALSE(ack.timed_out);
+	EXPECT_EQ("ok set roll 2 pitch 0", ack.reply);
+	EXPECT_EQ(0, serial.Outstanding());
+}
+
+TEST_F(SerialComTest, MatchesWholeEchoedCommand) {
+	SerialCom serial(address_, 5.0);
+	const uint64_t lost = serial.Send("set roll 1");
+	const uint64_t seq = serial.Send("set roll 10");
+	std::string line;
+	ASSERT_TRUE(ReadCommand(&line));
+	ASSERT_TRUE(ReadCommand(&line));
+	Reply("ok set roll 10\r\n");	//holds "set roll 1" but does not echo it
+	SerialCom::Ack ack;
+	ASSERT_TRUE(WaitAck(&serial, &ack));
+	EXPECT_EQ(lost, ack.seq);
+	EXPECT_TRUE(ack.timed_out);
+	ASSERT_TRUE(WaitAck(&serial, &ack));
+	EXPECT_EQ(seq, ack.seq);
+	EXPECT_EQ("ok set roll 10", ack.reply);
+}
+
+TEST_F(SerialComTest, CompletesPartialWrites) {
+	SerialCom serial(address_, 5.0);
+	//longer than the terminal buffer, the port only takes it in parts once the controller reads
+	const std::string long_command = "set" + std::string(20000, ' ') + "roll 1";
+	const uint64_t seq = serial.Send(long_command);
+	const uint64_t next = serial.Send("set roll 2");
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_EQ(2, serial.Outstanding());
+	std::string line;
+	ASSERT_TRUE(ReadCommand(&line, 7));
+	EXPECT_EQ(long_command, line);
+	ASSERT_TRUE(ReadCommand(&line));
+	EXPECT_EQ("set roll 2", line);
+	//replies split across reads
+	Reply("ok");
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	Reply("\r\nok set ");
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	Reply("roll 2\r\n");
+	SerialCom::Ack ack;
+	ASSERT_TRUE(WaitAck(&serial, &ack));
+	EXPECT_EQ(seq, ack.seq);
+	EXPECT_EQ("ok", ack.reply);
+	EXPECT_FALSE(ack.timed_out);
+	ASSERT_TRUE(WaitAck(&serial, &ack));
+	EXPECT_EQ(next, ack.seq);
+	EXPECT_EQ("ok set roll 2", ack.reply);
+	EXPECT_EQ(0, serial.Outstanding());
+}
+
+}	//namespace
+
+int main(int argc, char **argv) {
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}